@@ -0,0 +1,18 @@
+# 可选的块压缩库: 找到 LZ4/Zstd 时为目标打开对应的压缩算法, 找不到时只有内置的 LZ 压缩
+function(lsm_enable_compression target)
+  find_path(LZ4_INCLUDE_DIR lz4.h)
+  find_library(LZ4_LIBRARY lz4)
+  if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+    target_compile_definitions(${target} PRIVATE LSM_HAVE_LZ4)
+    target_include_directories(${target} PRIVATE ${LZ4_INCLUDE_DIR})
+    target_link_libraries(${target} ${LZ4_LIBRARY})
+  endif()
+
+  find_path(ZSTD_INCLUDE_DIR zstd.h)
+  find_library(ZSTD_LIBRARY zstd)
+  if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+    target_compile_definitions(${target} PRIVATE LSM_HAVE_ZSTD)
+    target_include_directories(${target} PRIVATE ${ZSTD_INCLUDE_DIR})
+    target_link_libraries(${target} ${ZSTD_LIBRARY})
+  endif()
+endfunction()
@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 跳表节点使用的内存池: 指针递增分配, 不支持单独释放,
+// 所有内存在 Arena 析构时(即 memtable 刷盘后被丢弃时)一次性归还
+class Arena {
+ public:
+  Arena();
+  ~Arena() = default;
+
+  // 禁止拷贝
+  Arena(const Arena&)            = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // 分配 bytes 字节, 不保证对齐, 适合 key/value 等字节数据
+  char* allocate(std::size_t bytes);
+
+  // 按指针大小对齐分配, 适合节点头和前向指针塔
+  char* allocate_aligned(std::size_t bytes);
+
+  // 多个写者并发分配时使用: 线程按 id 映射到分片, 只在分片内加锁,
+  // 不同分片的线程互不竞争
+  char* allocate_aligned_concurrent(std::size_t bytes);
+
+  // Arena 实际向系统申请的内存总量(包括块内碎片)
+  std::size_t memory_usage() const;
+
+ private:
+  static constexpr std::size_t kBlockSize = 4096;
+  static constexpr std::size_t kShards    = 8;
+
+  // 并发分配的分片, 按缓存行对齐避免伪共享
+  struct alignas(64) Shard {
+    std::mutex  mutex;
+    char*       alloc_ptr             = nullptr;
+    std::size_t alloc_bytes_remaining = 0;
+  };
+
+  char* allocate_fallback(std::size_t bytes);
+  char* allocate_new_block(std::size_t block_bytes);
+
+  char*                                alloc_ptr_;              // 当前块中下一个可用位置
+  std::size_t                          alloc_bytes_remaining_;  // 当前块剩余字节
+  std::vector<std::unique_ptr<char[]>> blocks_;                 // 已分配的内存块
+  std::atomic_size_t                   memory_usage_;           // 总内存占用
+  std::mutex                           blocks_mutex_;           // 保护 blocks_
+  std::array<Shard, kShards>           shards_;                 // 并发分配分片
+};
+
+inline char* Arena::allocate(std::size_t bytes) {
+  if (bytes <= alloc_bytes_remaining_) {
+    char* result = alloc_ptr_;
+    alloc_ptr_ += bytes;
+    alloc_bytes_remaining_ -= bytes;
+    return result;
+  }
+  return allocate_fallback(bytes);
+}
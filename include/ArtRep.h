@@ -0,0 +1,83 @@
+#pragma once
+#include "MemTableRep.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// 自适应基数树(ART)表示: key 的公共前缀只在树上比较一次, 适合共享长前缀的 key.
+// 所有版本节点和跳表一样串成一条按 (key 升序, transaction_id 降序) 排列的链表,
+// 树的叶子指向每个 key 在链表中的第一个和最后一个版本, 因此可以直接用 SkiplistIterator 遍历.
+// 树本身由读写锁保护, 链表按跳表的方式发布, 迭代器遍历链表时不需要加锁
+class ArtRep : public MemTableRep {
+ public:
+  ArtRep();
+  ~ArtRep() override;
+
+  ArtRep(const ArtRep&)            = delete;
+  ArtRep& operator=(const ArtRep&) = delete;
+
+  bool  Insert(const std::string& key, const std::string& value,
+               uint64_t transaction_id = 0) override;
+  bool  InsertConcurrently(const std::string& key, const std::string& value,
+                           uint64_t transaction_id = 0) override;
+  Node* Get(const std::string& key, uint64_t transaction_id = 0) override;
+  SkiplistIterator get_iterator(const std::string& key, uint64_t transaction_id = 0) override;
+  // 前缀查询是一次子树定位: 子树最小叶子的第一个版本到最大叶子之后的节点
+  std::pair<SkiplistIterator, SkiplistIterator> prefix_range(
+      const std::string& key, uint64_t transaction_id = 0) override;
+  // 链表已经有序, 线性地用插入位置提示构建跳表
+  std::shared_ptr<Skiplist> sorted_view() override;
+  std::size_t               get_size() override;
+  std::size_t               memory_usage() const override;
+
+  SkiplistIterator begin();
+  SkiplistIterator end();
+  SkiplistIterator prefix_serach_begin(const std::string& key, uint64_t transaction_id = 0);
+  SkiplistIterator prefix_serach_end(const std::string& key, uint64_t transaction_id = 0);
+
+ private:
+  struct Leaf;
+  struct Inner;
+  struct Node4;
+  struct Node16;
+  struct Node48;
+  struct Node256;
+  // 子节点指针, 最低位为 1 表示叶子
+  using Child = uintptr_t;
+
+  static bool   is_leaf(Child child) { return (child & 1) != 0; }
+  static Leaf*  as_leaf(Child child) { return reinterpret_cast<Leaf*>(child & ~Child(1)); }
+  static Inner* as_inner(Child child) { return reinterpret_cast<Inner*>(child); }
+  static Child  leaf_child(Leaf* leaf) { return reinterpret_cast<Child>(leaf) | 1; }
+
+  static Child* find_child(Inner* node, uint8_t byte);
+  // 第一个字节 >= byte 的子节点, 不存在时返回 0
+  static Child first_child_from(Inner* node, int byte);
+  static Child last_child(Inner* node);
+  static Leaf* min_leaf(Child child);
+  static Leaf* max_leaf(Child child);
+
+  void  add_child(Child& slot, uint8_t byte, Child child);
+  Leaf* new_leaf(Node* node);
+  // 返回 key 对应的叶子, 第二个值表示叶子是否为新建的
+  std::pair<Leaf*, bool> insert_leaf(Child& slot, std::string_view key, std::size_t depth,
+                                     Node* node);
+  Leaf*                  find_leaf(std::string_view key) const;
+  // 第一个 key >= 目标的叶子
+  Leaf* lower_bound(Child child, std::string_view key, std::size_t depth) const;
+  // 链表中 key 的第一个对 transaction_id 可见的版本
+  static Node* first_visible(Leaf* leaf, uint64_t transaction_id);
+  void         free_tree(Child child);
+
+  std::shared_ptr<Arena>    arena_;           // 版本节点和叶子的内存池
+  Node*                     head;             // 链表头节点
+  Child                     root_      = 0;   // 树根
+  Leaf*                     leaf_tail_ = nullptr;  // key 最大的叶子
+  mutable std::shared_mutex mutex_;           // 保护树结构
+  std::atomic_size_t        size_bytes;       // key/value 字节数
+  std::atomic_size_t        inner_bytes;      // 内部节点占用
+};
@@ -1,5 +1,6 @@
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <utility>
 enum class IteratorType {
   SkiplistIterator,
@@ -21,6 +22,9 @@ class BaseIterator {
   virtual bool          isEnd()           = 0;
   virtual valuetype     operator*() const = 0;
   virtual uint64_t      getseq() const    = 0;
+  // 不拷贝的 key/value 视图, 迭代器移动之前有效; 需要保存时再转成 std::string
+  virtual std::string_view key() const   = 0;
+  virtual std::string_view value() const = 0;
 };
 class SerachIterator {
  public:
@@ -1,7 +1,11 @@
+#pragma once
+#include "Global.h"
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -9,42 +13,135 @@ class BlockIterator;
 class Block : public std::enable_shared_from_this<Block> {
  public:
   friend class BlockIterator;
+  // 块的编码格式. v1: 每个条目存完整的 key, 每个条目一个 uint16_t 偏移;
+  // v2: key 只存与上一条不同的后缀, 每隔 BLOCK_RESTART_INTERVAL 个条目一个存完整 key 的重启点;
+  // v3: 与 v2 相同的前缀压缩, 条目头的长度是变长整数, tranc_id 存与尾部中基准事务id的差值,
+  //     key 和 value 的长度不再受 uint16_t 限制
+  enum class Format : uint8_t {
+    kV1 = 1,
+    kV2 = 2,
+    kV3 = 3,
+  };
   Block();
-  explicit Block(std::size_t capacity);
-  std::vector<uint8_t> encode(bool with_hash = true);
+  explicit Block(std::size_t capacity, Format format = Format::kV3);
+  // v2/v3 的校验和是 CRC32C, 类型记录在尾部; v1 没有记录类型的位置, 仍使用 std::hash.
+  // compression 不是 kNone 时压缩整个块, 压缩效果不好时仍存原始块.
+  // with_hash_index 时 v2/v3 块附带 key 到重启点的哈希索引, 点查先查索引, 冲突时再二分
+  std::vector<uint8_t> encode(
+      bool                     with_checksum   = true,
+      Global_::CompressionType compression     = Global_::CompressionType::kNone,
+      bool                     with_hash_index = false);
 
-  static std::shared_ptr<Block> decode(const std::vector<uint8_t>& encoded, bool with_hash = true);
+  // 各种格式和压缩块都可以解码. 解码出的块是编码数据的只读视图, 条目和偏移都在原处读取,
+  // 压缩块解压到新的缓冲区; verify_checksum 为 false 时不计算校验和, 用于已经校验过的数据
+  static std::shared_ptr<Block> decode(const std::vector<uint8_t>& encoded,
+                                       bool with_checksum = true, bool verify_checksum = true);
+  static std::shared_ptr<Block> decode(std::vector<uint8_t>&& encoded, bool with_checksum = true,
+                                       bool verify_checksum = true);
+  // 零拷贝解码 [data, data + size), 块共享 owner 的所有权, 例如读缓冲区或 mmap 的 SST 区域
+  static std::shared_ptr<Block> decode(std::shared_ptr<const void> owner, const uint8_t* data,
+                                       std::size_t size, bool with_checksum = true,
+                                       bool verify_checksum = true);
   std::string                   get_first_key();
-  std::optional<size_t>         get_idx_binary(const std::string& key, uint64_t tranc_id = 0);
-  std::optional<size_t> get_prefix_begin_idx_binary(const std::string& key, uint64_t tranc_id = 0);
-  std::optional<size_t> get_prefix_end_idx_binary(const std::string& key, uint64_t tranc_id = 0);
+  // 查找相关的接口都基于 lower_bound, 直接比较块中的字节, 不分配内存
+  std::optional<size_t> get_idx_binary(std::string_view key, uint64_t tranc_id = 0);
+  std::optional<size_t> get_prefix_begin_idx_binary(std::string_view key, uint64_t tranc_id = 0);
+  std::optional<size_t> get_prefix_end_idx_binary(std::string_view key, uint64_t tranc_id = 0);
   std::optional<std::size_t> get_offset(const std::size_t index);
   std::size_t                get_cur_size() const;
+  Format                     format() const;
+  Global_::ChecksumType      checksum_type() const;
+  // 解码前的块的压缩算法
+  Global_::CompressionType   compression_type() const;
+  bool                       has_hash_index() const;
+  std::size_t                num_entries() const;
 
   std::optional<uint64_t>             get_tranc_id(const std::size_t offset) const;
-  std::optional<std::string>          get_value_binary(const std::string& key);
-  bool                                KeyExists(const std::string& key);
+  std::optional<std::string>          get_value_binary(std::string_view key);
+  bool                                KeyExists(std::string_view key);
   std::pair<std::string, std::string> get_first_and_last_key();
   bool          add_entry(const std::string& key, const std::string& value, uint64_t tranc_id,
                           bool force_write = false);
   bool          is_empty() const;
-  BlockIterator get_iterator(const std::string& key, uint64_t tranc_id = 0);
+  BlockIterator get_iterator(std::string_view key, uint64_t tranc_id = 0);
   BlockIterator begin();
   BlockIterator end();
   // BlockIterator                       current_iterator();
   std::optional<std::pair<std::shared_ptr<BlockIterator>, std::shared_ptr<BlockIterator>>>
-  get_prefix_iterator(std::string key, uint64_t tranc_id);
+  get_prefix_iterator(std::string_view key, uint64_t tranc_id);
 
  private:
-  std::vector<uint8_t>  Data_;
-  std::vector<uint16_t> Offset_;
-  std::size_t           capcity;
+  // 一个条目的各部分, 视图指向 Data_; v1 的 shared 总是 0
   struct Entry {
-    std::string key;
-    std::string value;
-    uint64_t    tranc_id;
+    uint32_t         shared;    // 与上一条 key 共享的前缀长度
+    std::string_view unshared;  // key 剩余的部分
+    std::string_view value;
+    uint64_t         tranc_id;
+    std::size_t      next;      // 下一个条目的偏移
+  };
+  // 顺序解码条目的位置. v2 的非重启点只存了 key 的后缀, 完整的 key 拼接在 key_buf 中
+  struct Cursor {
+    std::size_t index      = 0;  // 条目下标
+    std::size_t offset     = 0;  // 条目在条目区中的偏移
+    std::string key_buf;
+    bool        key_in_buf = false;  // 为 false 时 key 就是条目中的 unshared
   };
-  std::string                   get_key(const std::size_t offset) const;
-  std::string                   get_value(const std::size_t offset) const;
-  std::shared_ptr<Block::Entry> get_entry(std::size_t offset);
-};
\ No newline at end of file
+
+  // 条目区和重启点数组: 写入中的块在 Data_/Offset_ 中, 解码出的块在 buffer_ 中
+  const uint8_t* data() const;
+  std::size_t    data_size() const;
+  std::size_t    num_restarts() const;
+  uint32_t       restart_offset(std::size_t restart) const;
+
+  Entry parse_entry(std::size_t offset) const;
+  // 从 index 所在区间的重启点开始解码到第 index 个条目
+  void cursor_seek(Cursor& cursor, std::size_t index) const;
+  void cursor_next(Cursor& cursor) const;
+  // 用 cursor.offset 处的条目更新拼接的 key
+  void             cursor_load(Cursor& cursor) const;
+  std::string_view cursor_key(const Cursor& cursor) const;
+
+  // 查找时的位置, 以及条目的 key 与目标 key 的关系
+  struct Position {
+    std::size_t index  = 0;
+    std::size_t offset = 0;
+    std::size_t match  = 0;  // 与目标 key 的公共前缀长度
+    int         cmp    = 0;  // 条目的 key 与目标 key 的比较结果
+  };
+  // 第一个不小于 (key, tranc_id) 的条目. 条目按 key 升序、同一 key 按 tranc_id 降序排列,
+  // key 存在且有 tranc_id 可见的版本时定位到最新的可见版本. 先在重启点上二分,
+  // 区间内用共享前缀长度增量地比较, 不拼接 key
+  Position lower_bound(std::string_view key, uint64_t tranc_id) const;
+  // 重启点 restart 处的位置, key 完整存储, 直接比较
+  Position restart_position(std::size_t restart, std::string_view key) const;
+  // 移动到下一个条目并更新与 key 的比较结果
+  void advance(Position& pos, std::string_view key) const;
+  // 编码时按 key 的哈希把每个 key 第一次出现的重启点填入桶中
+  std::vector<uint8_t> build_hash_index() const;
+  // 用哈希索引定位 (key, tranc_id), 结果与 lower_bound 相同或者确定 key 不在块中;
+  // 没有索引或桶冲突时返回 std::nullopt
+  std::optional<Position> hash_seek(std::string_view key, uint64_t tranc_id) const;
+  // 点查: 先查哈希索引, 不能确定时用 lower_bound
+  Position point_seek(std::string_view key, uint64_t tranc_id) const;
+  // lower_bound 找到的条目与 key 相等时, 转换为迭代用的游标
+  void cursor_at(Cursor& cursor, const Position& pos, std::string_view key) const;
+
+  std::vector<uint8_t>     Data_;
+  std::vector<uint32_t>    Offset_;  // 重启点的偏移, v1 中每个条目都是重启点
+  std::size_t              capcity;
+  Format                   format_;
+  Global_::ChecksumType    checksum_type_;
+  Global_::CompressionType compression_      = Global_::CompressionType::kNone;
+  uint32_t                 num_entries_      = 0;
+  uint16_t                 restart_interval_ = 1;  // 每个重启点覆盖的条目数
+  uint64_t                 base_tranc_id_    = 0;  // v3 中条目的 tranc_id 相对它存储
+  std::string              last_key_;              // v2 写入时上一条的 key
+  // 解码出的块只读, 指向 buffer_ 中的条目区和按编码格式存储的重启点数组
+  std::shared_ptr<const void> buffer_;
+  const uint8_t*              view_data_         = nullptr;
+  std::size_t                 view_size_         = 0;
+  const uint8_t*              view_restarts_     = nullptr;
+  std::size_t                 view_num_restarts_ = 0;
+  const uint8_t*              view_hash_buckets_ = nullptr;  // 没有哈希索引时为空
+  std::size_t                 view_num_buckets_  = 0;
+};
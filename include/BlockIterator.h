@@ -1,12 +1,13 @@
 #pragma once
 
+#include "Block.h"
 #include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 
-class Block;
 class BlockIterator;
 bool operator==(const BlockIterator& lhs, const BlockIterator& rhs) noexcept;
 
@@ -24,7 +25,7 @@ class BlockIterator {
 
   // 构造函数
   BlockIterator();
-  BlockIterator(std::shared_ptr<Block> block_, const std::string& key, uint64_t tranc_id = 0);
+  BlockIterator(std::shared_ptr<Block> block_, std::string_view key, uint64_t tranc_id = 0);
   BlockIterator(std::shared_ptr<Block> block_, size_t index, uint64_t tranc_id = 0,
                 bool should_skip = true);
 
@@ -38,6 +39,11 @@ class BlockIterator {
 
   auto                   operator<=>(const BlockIterator& rhs) const -> std::strong_ordering;
   value_type             getValue() const;
+  // 当前条目的视图. value 直接指向 Block 的数据, 迭代器持有 Block 期间有效;
+  // v2 格式中非重启点的 key 拼接在迭代器内, 只在迭代器移动之前有效
+  std::string_view       key() const;
+  std::string_view       value() const;
+  uint64_t               tranc_id() const;
   size_t                 getIndex() const;
   std::shared_ptr<Block> get_block() const;
 
@@ -47,8 +53,8 @@ class BlockIterator {
   void skip_by_tranc_id();
 
  private:
-  std::shared_ptr<Block>    block;          // 指向所属的 Block
-  size_t                    current_index;  // 当前位置的索引
-  uint64_t                  tranc_id_;      // 当前事务 id
-  std::optional<value_type> cached_value;   // 缓存当前值
+  std::shared_ptr<Block>    block;         // 指向所属的 Block
+  Block::Cursor             cursor_;       // 当前位置的索引和解码出的 key
+  uint64_t                  tranc_id_;     // 当前事务 id
+  std::optional<value_type> cached_value;  // 缓存当前值
 };
\ No newline at end of file
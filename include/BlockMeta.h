@@ -1,3 +1,4 @@
+#include "Global.h"
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -6,8 +7,13 @@ class BlockMeta {
  public:
   BlockMeta();
   BlockMeta(std::string first_key, std::string last_key, size_t offset);
-  static std::vector<uint8_t>   encode_meta_to_slice(std::vector<BlockMeta>& meta);
-  static std::vector<BlockMeta> decode_meta_from_slice(std::vector<uint8_t>& slice);
+  // 校验和类型由 SST 文件尾部记录, 旧文件的元数据块使用 std::hash
+  static std::vector<uint8_t> encode_meta_to_slice(
+      std::vector<BlockMeta>& meta,
+      Global_::ChecksumType   checksum_type = Global_::ChecksumType::kCrc32c);
+  static std::vector<BlockMeta> decode_meta_from_slice(
+      std::vector<uint8_t>& slice,
+      Global_::ChecksumType checksum_type = Global_::ChecksumType::kCrc32c);
 
   std::string first_key_;
   std::string last_key_;
@@ -0,0 +1,21 @@
+#pragma once
+#include <memory>
+#include <string>
+
+class Skiplist;
+
+// memtable 检查点文件: 把一张跳表按 (key 升序, transaction_id 降序) 写成有序的记录,
+// 启动时通过 mmap 直接读取, 无需逐个 key 重新查找插入位置.
+// 文件格式:
+// | 数据块 ... | 公共前缀 | 块索引 | 尾部 |
+// 数据块中的记录: | transaction_id(8) | key 长度(4) | value 长度(4) | key | value |,
+// 记录不跨块; 块索引每项为 | 偏移(8) | 长度(8) | 记录数(4) | crc32c(4) |;
+// 尾部: | 公共前缀长度(4) | 块数(4) | crc32c(4) | 记录数(8) | 版本(4) | 魔数(4) |,
+// 尾部的 crc 覆盖公共前缀, 块索引以及尾部的前两个字段
+class Checkpoint {
+ public:
+  // 先写临时文件, 落盘后再重命名, 崩溃时不会留下不完整的检查点
+  static void write(const std::string& path, Skiplist& table);
+  // 多个线程并行校验和解析数据块, 再按顺序一次性链接进新的跳表; 文件损坏时抛出异常
+  static std::shared_ptr<Skiplist> load(const std::string& path);
+};
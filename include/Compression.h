@@ -0,0 +1,18 @@
+#pragma once
+#include "Global.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 数据块的压缩. kLz 总是可用; kLz4/kZstd 只有构建时找到对应的库
+// (定义 LSM_HAVE_LZ4/LSM_HAVE_ZSTD) 才可用
+bool compression_supported(Global_::CompressionType type);
+// level 层 SST 使用的压缩算法, 配置的算法不可用时退回 kLz
+Global_::CompressionType compression_for_level(std::size_t level);
+
+// 把 [data, data + size) 压缩后追加到 out, 算法不可用时返回 false 且不修改 out
+bool compress(Global_::CompressionType type, const uint8_t* data, std::size_t size,
+              std::vector<uint8_t>& out);
+// 解压出 raw_size 字节, 数据损坏或算法不可用时抛出 std::runtime_error
+std::vector<uint8_t> decompress(Global_::CompressionType type, const uint8_t* data,
+                                std::size_t size, std::size_t raw_size);
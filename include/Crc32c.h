@@ -0,0 +1,15 @@
+#pragma once
+#include "Global.h"
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C(Castagnoli) 校验和, 用于日志、检查点文件、数据块和元数据块;
+// crc 为已有数据的校验和, 可以分段计算. 有 SSE4.2/ARMv8 CRC 指令时用指令计算
+uint32_t crc32c(const void* data, std::size_t size, uint32_t crc = 0);
+// 不使用 CRC 指令的 slicing-by-8 实现, 结果与 crc32c 相同
+uint32_t crc32c_portable(const void* data, std::size_t size, uint32_t crc = 0);
+// crc32c 是否使用了 CRC 指令
+bool crc32c_hardware_accelerated();
+
+// 按 type 计算块和元数据块的校验和
+uint32_t compute_checksum(Global_::ChecksumType type, const void* data, std::size_t size);
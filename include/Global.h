@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <random>
 namespace Global_ {
 constexpr int    MAX_MEMTABLE_SIZE_PER_TABLE       = 1024 * 1024 * 4;   // 4MB
@@ -9,11 +10,57 @@ constexpr int    Block_CACHE_K                     = 8;
 constexpr int    LSM_SST_LEVEL_RATIO               = 4;
 constexpr int    bloom_filter_expected_size_       = 65536;
 constexpr double bloom_filter_expected_error_rate_ = 0.1;
+constexpr int    MEMTABLE_HASH_BUCKETS             = 1 << 14;  // 哈希表示的桶数
+constexpr int    MAX_IMMUTABLE_MEMTABLES           = 4;        // 超过后写者等待后台刷盘
+constexpr int    WAL_SYNC_INTERVAL_MS              = 100;      // kPeriodic 模式的落盘间隔
+constexpr int    WAL_MAX_GROUP_BYTES               = 1 << 20;  // 一个提交组合并的最大字节数
+constexpr int    CHECKPOINT_CHUNK_BYTES            = 1 << 20;  // 检查点文件分块校验的块大小
+constexpr int    CHECKPOINT_INTERVAL_MS            = 60000;    // 后台写检查点的间隔
+constexpr int    MEMTABLE_FILTER_BITS_PER_KEY      = 10;       // 冻结表过滤器每个 key 的位数
+constexpr int    MEMTABLE_PARTITIONS               = 16;       // 分片表示的分片数
+constexpr int    BLOCK_RESTART_INTERVAL            = 16;       // 数据块中重启点的间隔(条目数)
+constexpr int    COMPRESSION_MIN_SAVING_PERCENT    = 12;       // 压缩块至少节省的百分比
+constexpr double BLOCK_HASH_INDEX_UTIL_RATIO       = 0.75;     // 块内哈希索引每个桶的平均 key 数
 enum class SkiplistStatus {
   kNormal,
   KFreezing,
   kFrozen,
 };
+// 活跃 memtable 的存储结构
+enum class MemTableRepType {
+  kSkiplist,     // 有序跳表, 支持并发写和范围查询
+  kVector,       // 追加写的数组, 冻结时排序一次, 适合批量导入
+  kHash,         // 哈希桶, 只适合点查, 冻结时排序一次
+  kArt,          // 自适应基数树, 适合共享长前缀的 key, 前缀查询是一次子树定位
+  kPartitioned,  // 按 key 范围分片的跳表, 写入不同范围的写者互不竞争
+};
+
+// 预写日志的落盘方式
+enum class WalSyncMode {
+  kNone,      // 只写入页缓存, 由操作系统决定何时落盘
+  kPerBatch,  // 每个提交组写入后 fdatasync 一次
+  kPeriodic,  // 后台线程按固定间隔 fdatasync
+};
+
+// 数据块和元数据块的校验和算法, 记录在块尾部和 SST 文件尾部
+enum class ChecksumType : uint8_t {
+  kStdHash = 0,  // 旧文件使用: std::hash 截断为 32 位, 结果依赖标准库实现
+  kCrc32c  = 1,  // CRC32C, 有 SSE4.2/ARMv8 CRC 指令时用指令计算
+};
+
+// 数据块的压缩算法, 记录在压缩块的尾部
+enum class CompressionType : uint8_t {
+  kNone = 0,
+  kLz   = 1,  // 内置的 LZ 压缩, 不依赖第三方库
+  kLz4  = 2,  // 需要构建时找到 LZ4
+  kZstd = 3,  // 需要构建时找到 Zstd
+};
+// 各层 SST 数据块的压缩算法, 更深的层使用最后一项; 算法不可用时退回 kLz
+constexpr CompressionType LEVEL_COMPRESSION[] = {
+    CompressionType::kLz,
+    CompressionType::kLz4,
+    CompressionType::kZstd,
+};
 
 int generateRandom(int begin = 0, int end = 1000);
 
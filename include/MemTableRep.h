@@ -0,0 +1,124 @@
+#pragma once
+#include "Arena.h"
+#include "Global.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class Node;
+class Skiplist;
+class SkiplistIterator;
+
+// memtable 的存储结构接口. 活跃表可以按负载选择不同的实现,
+// 冻结时统一通过 sorted_view() 转换成有序的跳表, 所以不可变表总是跳表
+class MemTableRep {
+ public:
+  virtual ~MemTableRep() = default;
+
+  // 单写者插入
+  virtual bool Insert(const std::string& key, const std::string& value,
+                      uint64_t transaction_id = 0) = 0;
+  // 多写者并发插入
+  virtual bool InsertConcurrently(const std::string& key, const std::string& value,
+                                  uint64_t transaction_id = 0) = 0;
+  // 单写者批量插入, sorted 已按 key 排好序
+  virtual void InsertBatch(const std::vector<const std::pair<std::string, std::string>*>& sorted,
+                           uint64_t transaction_id);
+
+  // 读取 transaction_id 可见的最新版本, 0 表示读最新版本
+  virtual Node*                      Get(const std::string& key, uint64_t transaction_id = 0) = 0;
+  virtual std::optional<std::string> Contain(const std::string& key, uint64_t transaction_id = 0);
+  // 定位到 key 可见的最新版本的游标. 有序的表示可以继续双向移动和重新定位;
+  // 无序的表示(数组和哈希)只做一次点查, 返回只含这一个条目的游标, 不能移动
+  virtual SkiplistIterator get_iterator(const std::string& key, uint64_t transaction_id = 0) = 0;
+  // 批量点查, sorted 已按 key 排好序; nodes[i] 是 sorted[i] 可见的最新版本, 不存在时为 nullptr
+  virtual void GetBatch(const std::vector<const std::string*>& sorted, uint64_t transaction_id,
+                        std::vector<Node*>& nodes);
+
+  // 按 (key 升序, transaction_id 降序) 排列的只读视图; 跳表直接返回自身,
+  // 其他实现排序后构建一张新的跳表, 冻结和范围查询都通过它完成
+  virtual std::shared_ptr<Skiplist> sorted_view() = 0;
+  // 前缀查询的 [begin, end) 区间, 默认在 sorted_view() 上做两次定位
+  virtual std::pair<SkiplistIterator, SkiplistIterator> prefix_range(const std::string& key,
+                                                                     uint64_t transaction_id = 0);
+
+  virtual std::size_t get_size()           = 0;
+  virtual std::size_t memory_usage() const = 0;
+};
+
+// 按类型创建活跃表, common_prefix 只对跳表有效
+std::shared_ptr<MemTableRep> make_memtable_rep(Global_::MemTableRepType type,
+                                               std::string_view         common_prefix = "");
+
+// 无序表示的排序视图缓存: 两次写入之间的范围查询和遍历共用同一份视图, 有写入后下次使用时重建
+class SortedViewCache {
+ public:
+  // 写入对 collect 可见之后调用
+  void note_write() { writes_.fetch_add(1, std::memory_order_release); }
+  // collect 按写入顺序返回当前所有条目
+  std::shared_ptr<Skiplist> get(const std::function<std::vector<Node*>()>& collect);
+
+ private:
+  std::atomic_uint64_t      writes_{0};
+  std::mutex                mutex_;
+  std::shared_ptr<Skiplist> view_;             // 没有建过视图时为空
+  uint64_t                  view_writes_ = 0;  // 建视图时的写入次数
+};
+
+// 追加写的数组: 插入只是一次追加, 点查从后往前扫描, 冻结时排序一次
+class VectorRep : public MemTableRep {
+ public:
+  VectorRep();
+
+  bool  Insert(const std::string& key, const std::string& value,
+               uint64_t transaction_id = 0) override;
+  bool  InsertConcurrently(const std::string& key, const std::string& value,
+                           uint64_t transaction_id = 0) override;
+  Node* Get(const std::string& key, uint64_t transaction_id = 0) override;
+  SkiplistIterator          get_iterator(const std::string& key,
+                                         uint64_t           transaction_id = 0) override;
+  std::shared_ptr<Skiplist> sorted_view() override;
+  std::size_t               get_size() override;
+  std::size_t               memory_usage() const override;
+
+ private:
+  std::shared_ptr<Arena> arena_;
+  std::vector<Node*>     entries_;  // 按写入顺序排列
+  mutable std::shared_mutex mutex_;
+  std::atomic_size_t        size_bytes;
+  SortedViewCache           view_;
+};
+
+// 哈希桶: 每个桶是按写入顺序从新到旧的无锁链表, 只支持点查, 冻结时排序一次
+class HashRep : public MemTableRep {
+ public:
+  explicit HashRep(std::size_t bucket_count = Global_::MEMTABLE_HASH_BUCKETS);
+
+  bool  Insert(const std::string& key, const std::string& value,
+               uint64_t transaction_id = 0) override;
+  bool  InsertConcurrently(const std::string& key, const std::string& value,
+                           uint64_t transaction_id = 0) override;
+  Node* Get(const std::string& key, uint64_t transaction_id = 0) override;
+  SkiplistIterator          get_iterator(const std::string& key,
+                                         uint64_t           transaction_id = 0) override;
+  std::shared_ptr<Skiplist> sorted_view() override;
+  std::size_t               get_size() override;
+  std::size_t               memory_usage() const override;
+
+ private:
+  std::atomic<Node*>& bucket(std::string_view key);
+
+  std::shared_ptr<Arena>                 arena_;
+  std::unique_ptr<std::atomic<Node*>[]> buckets_;
+  std::size_t                            bucket_count_;
+  std::atomic_size_t                     size_bytes;
+  SortedViewCache                        view_;
+};
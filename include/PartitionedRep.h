@@ -0,0 +1,53 @@
+#pragma once
+#include "MemTableRep.h"
+#include "Skiplist.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 按 key 范围分片的表示: 每个分片是一张独立的跳表和一把写锁, 写入不同范围的写者互不竞争.
+// key 先由 Skiplist::get_range_index 映射到范围, 范围 r 交错地分配给分片 r % 分片数,
+// 这样公共前缀之后只用到少数几种字节(如数字)的 key 也能分散到不同分片.
+// 每个范围是一段连续的 key, 按范围编号依次取出各段就是整张表的有序视图. 读者和跳表一样不加锁
+class PartitionedRep : public MemTableRep {
+ public:
+  explicit PartitionedRep(std::string_view common_prefix = "",
+                          int              partitions    = Global_::MEMTABLE_PARTITIONS);
+
+  bool  Insert(const std::string& key, const std::string& value,
+               uint64_t transaction_id = 0) override;
+  // 同一分片的写者在分片锁上串行, 分片内用插入位置提示插入
+  bool  InsertConcurrently(const std::string& key, const std::string& value,
+                           uint64_t transaction_id = 0) override;
+  // 有序的批次按分片切成连续的几段, 每段只加一次分片锁
+  void  InsertBatch(const std::vector<const std::pair<std::string, std::string>*>& sorted,
+                    uint64_t transaction_id) override;
+  Node* Get(const std::string& key, uint64_t transaction_id = 0) override;
+  SkiplistIterator get_iterator(const std::string& key, uint64_t transaction_id = 0) override;
+  void GetBatch(const std::vector<const std::string*>& sorted, uint64_t transaction_id,
+                std::vector<Node*>& nodes) override;
+  // 前缀比公共前缀长时所有匹配的 key 都在同一个分片内, 直接在该分片上定位
+  std::pair<SkiplistIterator, SkiplistIterator> prefix_range(
+      const std::string& key, uint64_t transaction_id = 0) override;
+  // 按范围编号依次取出每个范围的节点, 追加到一张新跳表的末尾
+  std::shared_ptr<Skiplist> sorted_view() override;
+  std::size_t               get_size() override;
+  std::size_t               memory_usage() const override;
+
+ private:
+  // 每个分片独占缓存行, 相邻分片的写锁不会伪共享
+  struct alignas(64) Partition {
+    std::mutex                write_mutex;
+    std::shared_ptr<Skiplist> table;
+  };
+
+  Partition& partition(std::string_view key);
+
+  std::string                  common_prefix_;
+  int                          partition_count_;
+  std::unique_ptr<Partition[]> partitions_;
+};
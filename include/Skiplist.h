@@ -1,12 +1,17 @@
 #pragma once
+#include "Arena.h"
 #include "BaseIterator.h"
+#include "BlockedBloomFilter.h"
+#include "MemTableRep.h"
 #include <array>
 #include <atomic>
 #include <memory>
+#include <new>
 #include <optional>
 #include <random>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include "../include/Global.h"
@@ -14,15 +19,45 @@
 const int MAX_LEVEL = 16;
 
 class SkiplistIterator;
+// 节点头, key, value 和高度可变的前向指针塔一起从 Arena 中连续分配;
+// 节点一旦链接进跳表就不再修改, 只有前向指针会被原子地更新.
+// 同一个 key 的每个版本各占一个节点, 按 transaction_id 从新到旧排列
 class Node {
  public:
-  std::string                        key_;
-  std::string                        value_;
-  std::vector<std::shared_ptr<Node>> forward;
-  uint64_t                           transaction_id;
-  Node(const std::string& key, const std::string& value, int level, uint64_t transaction_ids = 0)
-      : key_(key), value_(value), forward(level, nullptr), transaction_id(transaction_ids) {}
+  // 去掉跳表公共前缀后 key 的前 8 个字节(大端, 不足补 0), 大多数比较只需比较这个整数
+  uint64_t         key_prefix = 0;
+  std::string_view key_;
+  std::string_view value_;
+  uint64_t         transaction_id;
+  int              height;
+  bool             prefixed = false;  // key 是否以跳表的公共前缀开头, 否则 key_prefix 无效
+  Node(std::string_view key, std::string_view value, int level, uint64_t transaction_ids = 0)
+      : key_(key), value_(value), transaction_id(transaction_ids), height(level) {
+    for (int i = 0; i < level; ++i) {
+      new (&forward[i]) std::atomic<Node*>(nullptr);
+    }
+  }
   auto operator<=>(const Node& other) const;
+
+  // 从 Arena 分配节点: [Node][额外的 level-1 个前向指针][key][value]
+  static Node* create(Arena& arena, std::string_view key, std::string_view value, int level,
+                      uint64_t transaction_id, bool concurrent);
+
+  // acquire 读, 保证看到的节点已完全初始化
+  Node* next(int level) const { return forward[level].load(std::memory_order_acquire); }
+  // release 写, 发布节点给并发的读者
+  void  set_next(int level, Node* node) { forward[level].store(node, std::memory_order_release); }
+  Node* no_barrier_next(int level) const { return forward[level].load(std::memory_order_relaxed); }
+  void  no_barrier_set_next(int level, Node* node) {
+    forward[level].store(node, std::memory_order_relaxed);
+  }
+  bool cas_next(int level, Node* expected, Node* node) {
+    return forward[level].compare_exchange_strong(expected, node);
+  }
+
+ private:
+  // 实际长度为 height, 多出的部分紧跟在节点之后分配
+  std::atomic<Node*> forward[1];
 };
 
 bool operator==(const SkiplistIterator& lhs, const SkiplistIterator& rhs) noexcept;
@@ -32,7 +67,7 @@ class SkiplistIterator : public BaseIterator {
 
  public:
   using valuetype = std::pair<std::string, std::string>;
-  SkiplistIterator(std::shared_ptr<Node> skiplist);
+  SkiplistIterator(Node* node, std::shared_ptr<Arena> arena = nullptr, Node* head = nullptr);
   SkiplistIterator();
   ~SkiplistIterator() = default;
   BaseIterator& operator++() override;
@@ -45,50 +80,170 @@ class SkiplistIterator : public BaseIterator {
   IteratorType                        type() const override;
   uint64_t                            getseq() const override;
   std::pair<std::string, std::string> getValue() const;
+  // 当前节点的 key/value, 指向 Arena 中的数据, 迭代器存活期间有效
+  std::string_view key() const override;
+  std::string_view value() const override;
+
+  // 以下定位操作都是自顶向下的查找, 复杂度 O(log n); 需要迭代器由跳表创建(持有头节点).
+  // 没有头节点的游标(无序表示的点查结果)只含一个条目, ++ 和定位操作都使它变为无效
+  // 定位到第一个 >= (key, transaction_id) 的节点
+  void Seek(std::string_view key, uint64_t transaction_id = UINT64_MAX);
+  void SeekToFirst();
+  void SeekToLast();
+  // 定位到最后一个 key <= 目标的节点(同 key 多个版本时为最旧的版本)
+  void SeekForPrev(std::string_view key);
+  // 移动到前一个节点, 已经在第一个节点时变为无效
+  void Prev();
 
  private:
-  std::shared_ptr<Node> current;
+  // 把定位到的节点调整为同一版本的重复写入中最新的那个, 与正向迭代的结果保持一致
+  void settle(Node* node);
+
+  Node*                  current;
+  Node*                  head_ = nullptr;  // 跳表头节点, 同样分配在 Arena 中
+  std::shared_ptr<Arena> arena_;           // 持有跳表内存, 保证迭代器存活期间节点有效
 };
 
-class Skiplist {
+class Skiplist : public MemTableRep, public std::enable_shared_from_this<Skiplist> {
+  friend class SkiplistIterator;
+
  public:
-  Skiplist(int max_level_ = MAX_LEVEL)
-      : max_level(max_level_), current_level(1), size_bytes(0), nodecount(0), dis(0.0, 1.0) {
-    head = std::make_shared<Node>("", "", max_level_);
+  // common_prefix 是预计所有 key 共有的前缀, 节点缓存的 8 字节前缀从它之后开始取;
+  // 不以它开头的 key 仍然正确, 只是比较时退化为完整比较
+  Skiplist(int max_level_ = MAX_LEVEL, std::string_view common_prefix = "")
+      : arena_(std::make_shared<Arena>()),
+        max_level(max_level_),
+        current_level(1),
+        size_bytes(0),
+        nodecount(0),
+        delete_epoch(0) {
+    // 头节点的 key 不参与比较, 用来保存公共前缀, 迭代器只持有头节点也能拿到它
+    head = new_node(common_prefix, "", max_level_);
   }  // 默认最大16层
+  Skiplist(const Skiplist&)            = delete;
+  Skiplist& operator=(const Skiplist&) = delete;
+
+  // 插入位置提示(finger): 记录上一次插入时每一层的前驱和后继.
+  // 下一个 key 仍落在某一层的 [prev, next) 区间内时, 只需从该层往下查找,
+  // 单调递增的 key 几乎是 O(1) 追加
+  struct Splice {
+    int      height = 0;  // 有效层数, 0 表示还没有计算过
+    uint64_t epoch  = 0;  // 计算时跳表的删除纪元, 删除过节点后提示作废
+    Node*    prev[MAX_LEVEL];
+    Node*    next[MAX_LEVEL];
+  };
+
+  // 单写者插入, 可以与读者并发, 但不能与其他写者并发; 使用跳表内部记录的上一次插入位置
+  bool Insert(const std::string& key, const std::string& value,
+              uint64_t transaction_id = 0) override;
+  // 单写者插入, 使用调用方持有的插入位置提示, 插入后提示指向新节点
+  bool InsertHint(const std::string& key, const std::string& value, uint64_t transaction_id,
+                  Splice& splice);
+  // 多写者并发插入, 通过 CAS 链接前向指针, 读者全程无锁
+  bool InsertConcurrently(const std::string& key, const std::string& value,
+                          uint64_t transaction_id = 0) override;
+  // 有序批量插入, 所有 key 共用一个插入位置提示
+  void InsertBatch(const std::vector<const std::pair<std::string, std::string>*>& sorted,
+                   uint64_t transaction_id) override;
 
-  bool Insert(const std::string& key, const std::string& value, uint64_t transaction_id = 0);
+  // 批量构建用: 分配一个尚未链接的节点, 可以由多个线程并发调用
+  Node* AllocateNode(std::string_view key, std::string_view value, uint64_t transaction_id);
+  // 把已按 (key 升序, transaction_id 降序) 排好序且都排在现有节点之后的节点追加到表尾;
+  // 每一层只维护尾节点, 不做任何查找. 调用方需保证没有其他写者
+  void AppendSorted(const std::vector<Node*>& nodes);
 
+  // 删除会物理摘除该 key 的所有版本, 调用方需保证没有其他写者
   bool Delete(const std::string& key);
 
-  std::optional<std::string> Contain(const std::string& key, uint64_t transaction_id = 0);
-  std::shared_ptr<Node>      Get(const std::string& key, uint64_t transaction_id = 0);
+  // 读取 transaction_id 可见的最新版本(版本号 <= transaction_id), 0 表示读最新版本
+
+  std::optional<std::string> Contain(const std::string& key,
+                                     uint64_t           transaction_id = 0) override;
+  Node*                      Get(const std::string& key, uint64_t transaction_id = 0) override;
+  SkiplistIterator           get_iterator(const std::string& key,
+                                          uint64_t           transaction_id = 0) override;
+  // 有序批量点查, 所有 key 共用一个查找位置提示, 后一个 key 从前一个的位置继续向右查找
+  void GetBatch(const std::vector<const std::string*>& sorted, uint64_t transaction_id,
+                std::vector<Node*>& nodes) override;
+  // 跳表本身就是有序的, 直接返回自身
+  std::shared_ptr<Skiplist>                        sorted_view() override;
+  std::pair<SkiplistIterator, SkiplistIterator>    prefix_range(
+      const std::string& key, uint64_t transaction_id = 0) override;
   std::vector<std::pair<std::string, std::string>> flush();
-  std::size_t                                      get_size();
+  std::size_t                                      get_size() override;
+  std::size_t                                      memory_usage() const override;
   std::size_t                                      getnodecount();
-  int                                              get_range_index(const std::string& key);
+  // 第 level 层链接的节点数, 用于检查索引层是否完整
+  std::size_t                                      level_node_count(int level) const;
   auto                                             seekToFirst();
   auto                                             seekToLast();
   SkiplistIterator                                 end();
   SkiplistIterator                                 begin();
   SkiplistIterator prefix_serach_begin(const std::string& key, uint64_t transaction_id = 0);
   SkiplistIterator prefix_serach_end(const std::string& key, uint64_t transaction_id = 0);
+  // 当前跳表中所有 key 的公共前缀(第一个和最后一个 key 的公共前缀), 用作下一张表的前缀
+  std::string key_common_prefix();
 
   void                    set_status(Global_::SkiplistStatus status);
   Global_::SkiplistStatus get_status() const;
 
+  // key 所在的范围编号 [0, MAX_RANGES), 按公共前缀之后的第一个字节划分; 编号随 key 单调不减,
+  // 所以相邻的范围拼接起来仍然有序. 不以公共前缀开头的 key 落在两端的范围
+  static constexpr int MAX_RANGES = 256;
+  int                  get_range_index(std::string_view key) const;
+
+  // 为不再写入的表建立 key 过滤器, 需在表发布给读者之前调用
+  void build_key_filter();
+  // 返回 false 时表中一定没有该 key 的任何版本; 没有过滤器时总是返回 true
+  bool may_contain(std::string_view key) const;
+
  private:
-  static constexpr int                      MAX_RANGES = 256;  // 最大范围
-  std::shared_ptr<Node>                     head;
-  int                                       max_level;      // 最大层级
-  int                                       current_level;  // 当前层级
-  std::atomic_size_t                        size_bytes;     // 内存占用，达到。flush到disk
-  std::atomic_int                           nodecount = 0;  // 节点数量
-  std::array<std::shared_mutex, MAX_RANGES> range_lock;     // 分区锁
-  std::random_device                        rd;             // 随机数生成器
-  static thread_local std::mt19937          gen;            // 随机数引擎
-  std::uniform_real_distribution<>          dis;            // 随机数分布
+  std::shared_ptr<Arena>              arena_;         // 节点内存池, 随跳表一起释放
+  Node*                               head = nullptr;
+  int                                 max_level;      // 最大层级
+  std::atomic_int                     current_level;  // 当前层级
+  std::atomic_size_t                  size_bytes;     // 内存占用，达到。flush到disk
+  std::atomic_int                     nodecount = 0;  // 节点数量
+  std::atomic_uint64_t                delete_epoch;   // 每次删除节点后递增
+  Splice                              insert_hint;    // Insert 使用的插入位置提示
+  std::random_device                  rd;             // 随机数生成器
+  std::unique_ptr<BlockedBloomFilter> filter_;        // 冻结后建立的 key 过滤器
+  static thread_local std::mt19937    gen;            // 随机数引擎
 
   Global_::SkiplistStatus cur_status = Global_::SkiplistStatus::kNormal;
   int                     random_level();
+  int                     get_max_height() const;
+  Node* new_node(std::string_view key, std::string_view value, int level,
+                 uint64_t transaction_id = 0, bool concurrent = false);
+  // 查找用的 key, 预先按头节点保存的公共前缀算好 8 字节前缀, 每次查找只计算一次
+  struct SearchKey {
+    std::string_view key;
+    uint64_t         prefix;
+    bool             prefixed;
+  };
+  static SearchKey make_search_key(const Node* head, std::string_view key);
+  // 取 key 从 offset 开始的 8 个字节, 按大端拼成整数, 整数的大小关系与字节序一致
+  static uint64_t encode_prefix(std::string_view key, std::size_t offset);
+  // 节点按 (key 升序, transaction_id 降序) 排列, 判断 node 是否排在 (key, id) 之前
+  static bool node_before(const Node* node, const SearchKey& key, uint64_t transaction_id);
+  // 读取时 transaction_id 为 0 表示读最新版本
+  static uint64_t visible_id(uint64_t transaction_id);
+  // 查找第一个 >= (key, id) 的节点, 即 id 可见的第一个版本; prev 非空时记录每一层的前驱
+  Node* find_greater_or_equal(std::string_view key, uint64_t transaction_id, Node** prev) const;
+  static Node* find_greater_or_equal(Node* head, int height, std::string_view key,
+                                     uint64_t transaction_id, Node** prev);
+  // 查找最后一个 < (key, id) 的节点, 不存在时返回 head
+  static Node* find_less_than(Node* head, int height, std::string_view key,
+                              uint64_t transaction_id);
+  // 查找最后一个节点, 跳表为空时返回 head
+  static Node* find_last(Node* head, int height);
+  // 校验提示, 重新计算失效的层, 使 splice 在底层和 [0, link_height) 的每一层都夹住 (key, id)
+  void recompute_splice(std::string_view key, uint64_t transaction_id, Splice& splice,
+                        int link_height = 0) const;
+  // splice 在 level 层是否仍然夹住 (key, id): 前驱和后继相邻, 且 key 落在二者之间
+  bool splice_brackets(const Splice& splice, int level, const SearchKey& key,
+                       uint64_t transaction_id) const;
+  // 从 before 开始在指定层查找插入位置
+  void find_splice_for_level(const SearchKey& key, uint64_t transaction_id, Node* before,
+                             int level, Node** out_prev, Node** out_next) const;
 };
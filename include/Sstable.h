@@ -24,7 +24,11 @@ class Sstable : public std::enable_shared_from_this<Sstable> {
                                                                 const std::string&          first_key,
                                                                 const std::string&          last_key,
                                                                 std::shared_ptr<BlockCache> block_cache);
+  // 缓存中的块在从文件读入时已经校验过, 命中缓存时不再计算校验和
   std::shared_ptr<Block>              read_block(size_t block_idx);
+  // 为 false 时从文件读入的块也不校验, 例如上层已经校验过整个文件
+  void                                set_verify_checksums(bool verify);
+  Global_::ChecksumType               get_checksum_type() const;
   std::optional<size_t>               find_block_idx(const std::string& key);
   std::vector<std::shared_ptr<Block>> find_block_range(const std::string& key_prefix);
   size_t                              num_blocks() const;
@@ -50,6 +54,9 @@ class Sstable : public std::enable_shared_from_this<Sstable> {
   uint32_t bloom_offset;
   uint32_t meta_block_offset;
   uint32_t block_offset;
+  // 元数据块的校验和类型, 数据块的类型记录在各自的尾部
+  Global_::ChecksumType checksum_type    = Global_::ChecksumType::kCrc32c;
+  bool                  verify_checksums = true;
 
   std::string first_key;
   std::string last_key;
@@ -61,7 +68,9 @@ class Sstable : public std::enable_shared_from_this<Sstable> {
 
 class Sstbuild {
  public:
-  Sstbuild(size_t block_size, bool has_bloom);
+  // level 决定数据块的压缩算法, 见 Global_::LEVEL_COMPRESSION;
+  // block_hash_index 时每个数据块附带哈希索引, 加速块内点查
+  Sstbuild(size_t block_size, bool has_bloom, size_t level = 0, bool block_hash_index = true);
   void   clean();
   void   add(const std::string& key, const std::string& value, uint64_t tranc_id = 0);
   void   finish_block();
@@ -79,4 +88,6 @@ class Sstbuild {
   std::vector<BlockMeta>       block_metas;
   std::vector<uint8_t>         data;
   size_t                       block_size;
+  Global_::CompressionType     compression;
+  bool                         block_hash_index;
 };
\ No newline at end of file
@@ -40,10 +40,10 @@ class SstIterator : public BaseIterator {
       std::shared_ptr<Sstable> sst, std::string prefix, uint64_t tranc_id);
 
   void          set_end();
-  void          seek(const std::string& key);
-  std::string   key();
-  std::string   value();
-  bool          valid() const override;
+  void             seek(const std::string& key);
+  std::string_view key() const override;
+  std::string_view value() const override;
+  bool             valid() const override;
   bool          isEnd() override;
   bool          exists_key_prefix(std::string key) const;
   BaseIterator& operator++() override;
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// LEB128 变长整数: 每个字节存 7 位, 最高位为 1 表示后面还有字节. 块的条目头用它存长度和事务id
+
+inline std::size_t varint_length(uint64_t value) {
+  std::size_t len = 1;
+  for (; value >= 0x80; value >>= 7) {
+    ++len;
+  }
+  return len;
+}
+
+// 写入 dst, 返回写入后的位置; dst 至少有 varint_length(value) 个字节
+inline uint8_t* put_varint(uint8_t* dst, uint64_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    *dst++ = static_cast<uint8_t>(value | 0x80);
+  }
+  *dst++ = static_cast<uint8_t>(value);
+  return dst;
+}
+
+// 从 [p, limit) 读取一个变长整数, 返回读取后的位置; 数据不完整或超过 10 个字节时返回 nullptr.
+// 剩余至少 8 个字节时一次读入 8 个字节, 用结束位的掩码算出长度, 不逐字节分支:
+// 有 BMI2 时用 pext 拼接每个字节的低 7 位, 否则用三轮移位合并
+inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* limit, uint64_t* value) {
+  if (limit - p >= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(uint64_t));
+    uint64_t stops = ~word & 0x8080808080808080ull;
+    if (stops != 0) {
+      std::size_t len  = (__builtin_ctzll(stops) >> 3) + 1;
+      uint64_t    bits = len == 8 ? word : word & ((1ull << (len * 8)) - 1);
+#if defined(__BMI2__)
+      *value = _pext_u64(bits, 0x7f7f7f7f7f7f7f7full);
+#else
+      bits &= 0x7f7f7f7f7f7f7f7full;
+      bits = (bits & 0x007f007f007f007full) | ((bits & 0x7f007f007f007f00ull) >> 1);
+      bits = (bits & 0x00003fff00003fffull) | ((bits & 0x3fff00003fff0000ull) >> 2);
+      bits = (bits & 0x000000000fffffffull) | ((bits & 0x0fffffff00000000ull) >> 4);
+      *value = bits;
+#endif
+      return p + len;
+    }
+  }
+  // 靠近缓冲区末尾或者超过 8 个字节时逐字节读取
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < limit; shift += 7) {
+    uint8_t byte = *p++;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// 有符号的差值先做 zigzag 变换, 绝对值小的负数也只占很少的字节
+inline uint64_t zigzag_encode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Global.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 预写日志. 每条记录的格式:
+// | crc32c(4) | 长度(4) | transaction_id(8) | key 长度(4) | value 长度(4) | key | value |
+// crc 覆盖长度之后的所有字节, 删除记录的 value 为空(与 memtable 的删除标记一致).
+// 并发写者排队组成提交组: 队首的写者作为 leader 把整组记录合并成一次 write(和一次 fdatasync),
+// 其余写者等待 leader 完成
+class Wal {
+ public:
+  struct Record {
+    std::string key;
+    std::string value;
+    uint64_t    transaction_id;
+  };
+
+  explicit Wal(const std::string&         path,
+               Global_::WalSyncMode      sync_mode     = Global_::WalSyncMode::kPerBatch,
+               std::chrono::milliseconds sync_interval =
+                   std::chrono::milliseconds(Global_::WAL_SYNC_INTERVAL_MS));
+  ~Wal();
+
+  Wal(const Wal&)            = delete;
+  Wal& operator=(const Wal&) = delete;
+
+  // 追加一条记录, 返回时记录已写入文件(kPerBatch 模式下已落盘)
+  void add(std::string_view key, std::string_view value, uint64_t transaction_id);
+  // 一个批次的记录在同一次 write 中写入
+  void add_batch(const std::vector<std::pair<std::string, std::string>>& key_value_pairs,
+                 uint64_t                                                transaction_id);
+  // 立即把已写入的记录落盘
+  void sync();
+
+  // 读出日志中所有完整的记录, 遇到校验失败或被截断的尾部记录时停止
+  static std::vector<Record> read(const std::string& path);
+
+ private:
+  struct Writer {
+    std::vector<uint8_t>    records;
+    bool                    done = false;
+    bool                    ok   = false;
+    std::condition_variable cv;
+  };
+
+  static void encode_record(std::vector<uint8_t>& out, std::string_view key, std::string_view value,
+                            uint64_t transaction_id);
+  void        commit(Writer& writer);
+  bool        write_all(const std::vector<uint8_t>& buf);
+  void        sync_loop();
+
+  int                       fd_ = -1;
+  std::string               path_;
+  Global_::WalSyncMode      sync_mode_;
+  std::chrono::milliseconds sync_interval_;
+
+  std::mutex          mutex_;          // 保护写者队列
+  std::deque<Writer*> writers_;        // 等待提交的写者, 队首是 leader
+  bool                dirty_ = false;  // 有尚未落盘的写入
+
+  std::thread             sync_thread_;  // kPeriodic 模式下定期落盘
+  std::condition_variable sync_cv_;
+  bool                    stop_ = false;
+};
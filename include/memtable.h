@@ -1,11 +1,21 @@
 #pragma once
 #include "Skiplist.h"
 #include "Sstable.h"
+#include "Wal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <shared_mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 class MemTableIterator;
 bool operator==(const MemTableIterator& lhs, const MemTableIterator& rhs) noexcept;
@@ -16,6 +26,12 @@ class MemTableIterator : public BaseIterator {
   using valuetype = std::pair<std::string, std::string>;
   MemTableIterator(std::vector<SerachIterator> iter, uint64_t max_transaction_id);
   MemTableIterator(const SkiplistIterator& iter, uint64_t max_transaction_id);
+  // 在多张跳表上做归并的游标, tables 按从新到旧排列; 每个 key 只返回快照可见的最新版本,
+  // 跳过删除标记. 游标支持双向移动, 定位操作都是对每张表的 O(log n) 查找
+  MemTableIterator(std::vector<SkiplistIterator> tables, uint64_t max_transaction_id);
+  // 只返回以 prefix 开头的 key 的归并游标, 各表的游标应已定位到前缀的起点
+  MemTableIterator(std::vector<SkiplistIterator> tables, uint64_t max_transaction_id,
+                   std::string prefix);
   ~MemTableIterator() = default;
 
   bool valid() const override;
@@ -32,21 +48,55 @@ class MemTableIterator : public BaseIterator {
   void         pop_value();
   void         update_current_key_value() const;
 
+  // 当前 key/value 的视图, 游标无效时为空
+  std::string_view key() const override;
+  std::string_view value() const override;
+
+  // 以下操作只对归并游标有效
+  void SeekToFirst();
+  void SeekToLast();
+  // 定位到第一个 >= key 的可见 key
+  void Seek(const std::string& key);
+  // 定位到最后一个 <= key 的可见 key
+  void SeekForPrev(const std::string& key);
+  void Prev();
+
  private:
-  bool                               top_value_legal() const;
-  void                               skip_transaction_id();
+  bool top_value_legal() const;
+  void skip_transaction_id();
+  // 从各表当前位置开始, 找到第一个可见且不是删除标记的 key
+  void find_next_user_entry();
+  // 各表跳过 key 的所有版本
+  void skip_key(const std::string& key);
+  // 各表定位到 key 之前的最后一个条目
+  void position_before(const std::string& key);
+  // 各表已定位到某个 key 之前, 从其中最大的 key 开始向前找第一个可见的 key
+  void find_prev_user_entry();
+  // 表的游标有效且没有越过前缀范围
+  bool in_range(const SkiplistIterator& table) const;
+
   mutable std::shared_ptr<valuetype> current_value_;
-  std::shared_ptr<SkiplistIterator>  list_iter_;
+  std::vector<SkiplistIterator>      tables_;              // 归并游标的每张表, 新表在前
+  int                                current_table_ = -1;  // 当前 key 来自哪张表, -1 表示无效
+  std::optional<std::string>         prefix_;              // 前缀游标的范围
   std::priority_queue<SerachIterator, std::vector<SerachIterator>, std::greater<SerachIterator>>
            queue_;
   uint64_t max_transaction_id;
 };
 
+// 某一时刻活跃表和不可变表的快照, 发布后不再修改. 读者加载一份后无锁查找,
+// 持有期间其中的表不会被释放; 冻结和刷盘都是复制后整体替换
+struct MemTableVersion {
+  std::shared_ptr<MemTableRep>           active;               // 活跃表
+  std::vector<std::shared_ptr<Skiplist>> immutables;           // 不可写的跳表, 新的在前
+  size_t                                 immutable_bytes = 0;  // immutables 的跳表的大小
+};
+
 class MemTable {
   friend class MemTableIterator;  // 让 MemTableIterator 可以访问私有成员
 
  public:
-  MemTable();
+  explicit MemTable(Global_::MemTableRepType rep_type = Global_::MemTableRepType::kSkiplist);
   ~MemTable();
 
   void put(const std::string& key, const std::string& value, uint64_t transaction_id = 0);
@@ -68,10 +118,40 @@ class MemTable {
   void   remove_mutex(const std::string& key, uint64_t transaction_id = 0);
   void   remove_batch(const std::vector<std::string>& key_pairs, uint64_t transaction_id = 0);
   bool   IsFull();
+  // 同步刷盘, 刷盘线程运行时抛出 std::logic_error, 此时不可变表只由刷盘线程删除.
+  // flush 写入最旧的不可变表, flushsync 写入活跃表和所有不可变表; 写入的表的日志段
+  // 保留到调用方把 sstbuild 建成 SST 后调用 release_flushed_wal
   void   flush(Sstbuild& sstbuild);
   void   flushsync(Sstbuild& sstbuild);
+  void   release_flushed_wal();
   void   frozen_cur_table();
-  MemTableIterator begin();
+  // 打开预写日志: 日志按活跃表分段, 段文件为 <path>.<编号>. 按编号重放上次留下的段,
+  // 表满时冻结; 之后的写入先追加到活跃表的段再写入活跃表. 表刷盘或写入检查点后删除它的段.
+  // 与检查点一起使用时先调用 load_checkpoints
+  void open_wal(const std::string&   path,
+                Global_::WalSyncMode sync_mode = Global_::WalSyncMode::kPerBatch);
+  // 后台刷盘线程: 按从旧到新的顺序把不可变表写成 sst_dir 下编号递增的 SST 文件,
+  // 发布给读者后丢弃跳表. 不可变表堆积到 MAX_IMMUTABLE_MEMTABLES 张时冻结会阻塞写者
+  void start_flush_thread(std::shared_ptr<BlockCache> block_cache, const std::string& sst_dir,
+                          size_t first_sst_id = 0);
+  // 把队列中剩余的表全部刷盘后退出
+  void stop_flush_thread();
+  // 等待当前所有不可变表刷盘完成
+  void wait_for_flush();
+  // 已刷盘的 SST, 新的在前
+  std::vector<std::shared_ptr<Sstable>> get_flushed_ssts();
+  // 把所有表写成 dir 下的检查点文件: 不可变表只写一次, 活跃表每次写一份新的快照,
+  // 已刷盘丢弃的表对应的文件被删除
+  void checkpoint(const std::string& dir);
+  // 后台按固定间隔调用 checkpoint
+  void start_checkpoint_thread(const std::string&        dir,
+                               std::chrono::milliseconds interval =
+                                   std::chrono::milliseconds(Global_::CHECKPOINT_INTERVAL_MS));
+  void stop_checkpoint_thread();
+  // 启动时并行加载 dir 下的检查点文件, 按从旧到新的顺序恢复为不可变表
+  void load_checkpoints(const std::string& dir);
+  // 遍历所有表的归并游标, 可以正向或反向移动
+  MemTableIterator begin(uint64_t transaction_id = 0);
   MemTableIterator end();
   MemTableIterator prefix_serach(const std::string& key, uint64_t transaction_id = 0);
   enum class SkiplistStatus {
@@ -81,11 +161,74 @@ class MemTable {
   };
 
  private:
-  std::shared_ptr<Skiplist>            current_table;  // 活跃 SkipList
-  std::list<std::shared_ptr<Skiplist>> fixed_tables;   // 不可写的 SkipList==InmutTable
-  size_t                               fixed_bytes;    // fixed_tables的跳表的大小
-  std::shared_mutex                    fix_lock_;      // 保护当前跳表的锁
-  std::shared_mutex                    cur_lock_;
-  std::atomic<SkiplistStatus>          cur_status;  // 当前跳表的状态
+  // 当前表超过阈值时冻结, 并发写者中只有一个会真正执行冻结
+  void try_frozen_cur_table();
+  // 调用方需持有 cur_lock_ 的独占锁
+  void frozen_cur_table_locked();
+  // 读者看到的当前版本
+  std::shared_ptr<const MemTableVersion> current_version() const;
+  // 刷盘线程运行时, 不可变表过多则等待刷盘腾出位置
+  void wait_for_flush_room();
+  // 刷盘线程运行时同步刷盘会与它争抢同一张不可变表, 直接拒绝
+  void reject_if_flush_thread_running();
+  void flush_loop();
+  // 把不可变表写成一个 SST, 表中没有数据时返回空指针
+  std::shared_ptr<Sstable> build_sst(Skiplist& table);
+  void                     rethrow_flush_error();
+  std::string              wal_segment_path(uint64_t seq) const;
+  // 调用方持有 cur_lock_ 的独占锁, frozen 已经发布或被丢弃. 活跃表的日志段交给 frozen,
+  // 日志打开时换到新的段
+  void roll_wal_locked(const std::shared_ptr<Skiplist>& frozen);
+  // 调用方持有 wal_mutex_, 取出 tables 中的表的日志段
+  std::vector<uint64_t> take_wal_segments_locked(
+      const std::vector<std::shared_ptr<Skiplist>>& tables);
+  // 删除 durable 中的表的日志段, 这些表已写成 SST 或检查点
+  void retire_wal_segments(const std::vector<std::shared_ptr<Skiplist>>& durable);
+  // written 中的表已写入调用方的 sstbuild, 日志段等 release_flushed_wal 时删除
+  void defer_wal_segments(const std::vector<std::shared_ptr<Skiplist>>& written);
+  // 调用方持有 checkpoint_mutex_
+  void checkpoint_locked(const std::string& dir);
+
+  Global_::MemTableRepType     rep_type_;      // 活跃表的存储结构
+  std::shared_ptr<MemTableRep> current_table;  // 写者使用的活跃表, 受 cur_lock_ 保护
+  // 写者持有共享锁, 冻结持有独占锁, 保证冻结后不会再有写入落到旧的活跃表; 读者不加这把锁
+  std::shared_mutex                                   cur_lock_;
+  std::atomic<std::shared_ptr<const MemTableVersion>> version_;        // 读者原子地加载
+  std::mutex                                          version_mutex_;  // 串行化版本的替换
+  std::atomic<SkiplistStatus>                         cur_status;      // 当前跳表的状态
+
+  std::thread                         flush_thread_;
+  std::mutex                          flush_mutex_;            // 保护刷盘线程的状态
+  std::condition_variable             flush_cv_;               // 有新的不可变表或需要退出
+  std::condition_variable             room_cv_;                // 有不可变表刷盘完成
+  bool                                flush_running_ = false;
+  bool                                flush_stop_    = false;
+  std::exception_ptr                  flush_error_;            // 刷盘失败后写者收到的异常
+  std::shared_ptr<BlockCache>         block_cache_;
+  std::string                         sst_dir_;
+  size_t                              next_sst_id_ = 0;        // 下一个 SST 文件的编号
+  std::list<std::shared_ptr<Sstable>> flushed_ssts_;           // 新的在前
+  std::shared_mutex                   sst_lock_;               // 保护 flushed_ssts_
+
+  // 每张活跃表写自己的日志段 <wal_path_>.<编号>, 未打开日志时 wal_ 为空
+  std::unique_ptr<Wal>                        wal_;
+  std::string                                 wal_path_;
+  Global_::WalSyncMode                        wal_sync_mode_ = Global_::WalSyncMode::kPerBatch;
+  std::mutex                                  wal_mutex_;         // 保护日志段的归属
+  uint64_t                                    next_wal_seq_ = 1;  // 0 留给旧版本的日志文件
+  // 记录落在活跃表中的段, 冻结时交给冻结出的表
+  std::vector<uint64_t>                       active_wal_segments_;
+  // 已冻结的段及包含其最后一条记录的表, 表刷盘或写入检查点后删除段
+  std::map<uint64_t, std::weak_ptr<Skiplist>> wal_segments_;
+  // 表已写入同步刷盘的 sstbuild, 等 release_flushed_wal 时删除的段
+  std::vector<uint64_t>                       pending_wal_segments_;
+
+  std::mutex                                checkpoint_mutex_;   // 串行化检查点的写入和加载
+  std::map<size_t, std::weak_ptr<Skiplist>> checkpoints_;        // 已写入检查点的不可变表
+  std::optional<size_t>                     active_checkpoint_;  // 活跃表最近一份快照的编号
+  size_t                                    next_checkpoint_id_ = 0;
+  std::thread                               checkpoint_thread_;
+  std::condition_variable                   checkpoint_cv_;
+  bool                                      checkpoint_stop_ = false;
   // 保护当前跳表的读写锁
 };
\ No newline at end of file
@@ -33,10 +33,10 @@ class MmapFile {
   // 获取文件大小
   size_t size() const { return file_size_; }
 
- private:
-  // 获取映射的内存指针
+  // 获取映射的内存指针, 文件为空时为 nullptr
   void* data() const { return mapped_data_; }
 
+ private:
   // 创建文件并映射到内存
   bool create_and_map(const std::string& path, size_t size);
 
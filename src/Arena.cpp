@@ -0,0 +1,74 @@
+#include "../include/Arena.h"
+
+Arena::Arena() : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+
+char* Arena::allocate_aligned(std::size_t bytes) {
+  constexpr std::size_t align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  static_assert((align & (align - 1)) == 0, "Pointer size should be a power of 2");
+  std::size_t current_mod = reinterpret_cast<uintptr_t>(alloc_ptr_) & (align - 1);
+  std::size_t slop        = (current_mod == 0 ? 0 : align - current_mod);
+  std::size_t needed      = bytes + slop;
+  char*       result;
+  if (needed <= alloc_bytes_remaining_) {
+    result = alloc_ptr_ + slop;
+    alloc_ptr_ += needed;
+    alloc_bytes_remaining_ -= needed;
+  } else {
+    // 新块由 new[] 分配, 天然满足对齐
+    result = allocate_fallback(bytes);
+  }
+  return result;
+}
+
+char* Arena::allocate_aligned_concurrent(std::size_t bytes) {
+  constexpr std::size_t align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  // 分片内的分配都按 align 取整, 块首地址天然对齐, 因此每次分配都是对齐的
+  bytes = (bytes + align - 1) & ~(align - 1);
+  if (bytes > kBlockSize / 4) {
+    return allocate_new_block(bytes);
+  }
+
+  static std::atomic_size_t next_thread_id{0};
+  thread_local std::size_t  thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+  Shard&                    shard     = shards_[thread_id % kShards];
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (bytes > shard.alloc_bytes_remaining) {
+    shard.alloc_ptr             = allocate_new_block(kBlockSize);
+    shard.alloc_bytes_remaining = kBlockSize;
+  }
+  char* result = shard.alloc_ptr;
+  shard.alloc_ptr += bytes;
+  shard.alloc_bytes_remaining -= bytes;
+  return result;
+}
+
+std::size_t Arena::memory_usage() const {
+  return memory_usage_.load(std::memory_order_relaxed);
+}
+
+char* Arena::allocate_fallback(std::size_t bytes) {
+  if (bytes > kBlockSize / 4) {
+    // 大对象单独分配一个块, 避免浪费当前块的剩余空间
+    return allocate_new_block(bytes);
+  }
+  // 丢弃当前块的剩余空间
+  alloc_ptr_             = allocate_new_block(kBlockSize);
+  alloc_bytes_remaining_ = kBlockSize;
+
+  char* result = alloc_ptr_;
+  alloc_ptr_ += bytes;
+  alloc_bytes_remaining_ -= bytes;
+  return result;
+}
+
+char* Arena::allocate_new_block(std::size_t block_bytes) {
+  auto  block  = std::make_unique_for_overwrite<char[]>(block_bytes);
+  char* result = block.get();
+  {
+    std::lock_guard<std::mutex> lock(blocks_mutex_);
+    blocks_.push_back(std::move(block));
+  }
+  memory_usage_.fetch_add(block_bytes + sizeof(char*), std::memory_order_relaxed);
+  return result;
+}
@@ -0,0 +1,633 @@
+#include "../include/ArtRep.h"
+#include "../include/Skiplist.h"
+#include <algorithm>
+#include <mutex>
+
+namespace {
+constexpr uint8_t kNode4   = 4;
+constexpr uint8_t kNode16  = 16;
+constexpr uint8_t kNode48  = 48;
+constexpr uint8_t kNode256 = 0;  // 256 放不进 uint8_t
+
+std::size_t common_prefix_length(std::string_view lhs, std::string_view rhs) {
+  auto mismatch = std::mismatch(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  return mismatch.first - lhs.begin();
+}
+}  // namespace
+
+// 叶子对应一个 key, 同 key 的所有版本在链表中连续排列在 [first, last]
+struct ArtRep::Leaf {
+  std::string_view key;
+  Node*            first;
+  Node*            last;
+  Leaf*            prev = nullptr;  // key 顺序上的前一个叶子
+  Leaf*            next = nullptr;
+};
+
+struct ArtRep::Inner {
+  uint8_t     type;
+  uint16_t    count = 0;
+  std::string prefix;              // 压缩路径
+  Leaf*       terminal = nullptr;  // 恰好在此结束的 key, 排在所有子节点之前
+  explicit Inner(uint8_t node_type) : type(node_type) {}
+};
+
+// Node4/Node16: 按字节有序排列的 key 数组
+struct ArtRep::Node4 : Inner {
+  uint8_t keys[4]     = {};
+  Child   children[4] = {};
+  Node4() : Inner(kNode4) {}
+};
+struct ArtRep::Node16 : Inner {
+  uint8_t keys[16]     = {};
+  Child   children[16] = {};
+  Node16() : Inner(kNode16) {}
+};
+// Node48: 按字节索引到子节点槽位, 0 表示不存在
+struct ArtRep::Node48 : Inner {
+  uint8_t index[256]   = {};
+  Child   children[48] = {};
+  Node48() : Inner(kNode48) {}
+};
+struct ArtRep::Node256 : Inner {
+  Child children[256] = {};
+  Node256() : Inner(kNode256) {}
+};
+
+namespace {
+template <typename N>
+uintptr_t* find_sorted_child(N* node, uint8_t byte) {
+  for (int i = 0; i < node->count; ++i) {
+    if (node->keys[i] == byte) {
+      return &node->children[i];
+    }
+  }
+  return nullptr;
+}
+
+template <typename N>
+uintptr_t first_sorted_child_from(N* node, int byte) {
+  for (int i = 0; i < node->count; ++i) {
+    if (node->keys[i] >= byte) {
+      return node->children[i];
+    }
+  }
+  return 0;
+}
+
+template <typename N>
+void insert_sorted_child(N* node, uint8_t byte, uintptr_t child) {
+  int pos = 0;
+  while (pos < node->count && node->keys[pos] < byte) {
+    ++pos;
+  }
+  for (int i = node->count; i > pos; --i) {
+    node->keys[i]     = node->keys[i - 1];
+    node->children[i] = node->children[i - 1];
+  }
+  node->keys[pos]     = byte;
+  node->children[pos] = child;
+  node->count++;
+}
+
+template <typename From, typename To>
+void move_header(From* from, To* to) {
+  to->prefix   = std::move(from->prefix);
+  to->terminal = from->terminal;
+}
+}  // namespace
+
+ArtRep::ArtRep() : arena_(std::make_shared<Arena>()), size_bytes(0), inner_bytes(0) {
+  head = Node::create(*arena_, "", "", 1, 0, false);
+}
+
+ArtRep::~ArtRep() {
+  free_tree(root_);
+}
+
+void ArtRep::free_tree(Child child) {
+  if (child == 0 || is_leaf(child)) {
+    return;
+  }
+  Inner* node = as_inner(child);
+  switch (node->type) {
+    case kNode4: {
+      auto* n = static_cast<Node4*>(node);
+      for (int i = 0; i < n->count; ++i) {
+        free_tree(n->children[i]);
+      }
+      delete n;
+      break;
+    }
+    case kNode16: {
+      auto* n = static_cast<Node16*>(node);
+      for (int i = 0; i < n->count; ++i) {
+        free_tree(n->children[i]);
+      }
+      delete n;
+      break;
+    }
+    case kNode48: {
+      auto* n = static_cast<Node48*>(node);
+      for (int i = 0; i < 48; ++i) {
+        free_tree(n->children[i]);
+      }
+      delete n;
+      break;
+    }
+    default: {
+      auto* n = static_cast<Node256*>(node);
+      for (int i = 0; i < 256; ++i) {
+        free_tree(n->children[i]);
+      }
+      delete n;
+      break;
+    }
+  }
+}
+
+ArtRep::Child* ArtRep::find_child(Inner* node, uint8_t byte) {
+  switch (node->type) {
+    case kNode4:
+      return find_sorted_child(static_cast<Node4*>(node), byte);
+    case kNode16:
+      return find_sorted_child(static_cast<Node16*>(node), byte);
+    case kNode48: {
+      auto* n = static_cast<Node48*>(node);
+      return n->index[byte] ? &n->children[n->index[byte] - 1] : nullptr;
+    }
+    default: {
+      auto* n = static_cast<Node256*>(node);
+      return n->children[byte] ? &n->children[byte] : nullptr;
+    }
+  }
+}
+
+ArtRep::Child ArtRep::first_child_from(Inner* node, int byte) {
+  switch (node->type) {
+    case kNode4:
+      return first_sorted_child_from(static_cast<Node4*>(node), byte);
+    case kNode16:
+      return first_sorted_child_from(static_cast<Node16*>(node), byte);
+    case kNode48: {
+      auto* n = static_cast<Node48*>(node);
+      for (int b = byte; b < 256; ++b) {
+        if (n->index[b]) {
+          return n->children[n->index[b] - 1];
+        }
+      }
+      return 0;
+    }
+    default: {
+      auto* n = static_cast<Node256*>(node);
+      for (int b = byte; b < 256; ++b) {
+        if (n->children[b]) {
+          return n->children[b];
+        }
+      }
+      return 0;
+    }
+  }
+}
+
+ArtRep::Child ArtRep::last_child(Inner* node) {
+  switch (node->type) {
+    case kNode4: {
+      auto* n = static_cast<Node4*>(node);
+      return n->count ? n->children[n->count - 1] : 0;
+    }
+    case kNode16: {
+      auto* n = static_cast<Node16*>(node);
+      return n->count ? n->children[n->count - 1] : 0;
+    }
+    case kNode48: {
+      auto* n = static_cast<Node48*>(node);
+      for (int b = 255; b >= 0; --b) {
+        if (n->index[b]) {
+          return n->children[n->index[b] - 1];
+        }
+      }
+      return 0;
+    }
+    default: {
+      auto* n = static_cast<Node256*>(node);
+      for (int b = 255; b >= 0; --b) {
+        if (n->children[b]) {
+          return n->children[b];
+        }
+      }
+      return 0;
+    }
+  }
+}
+
+ArtRep::Leaf* ArtRep::min_leaf(Child child) {
+  while (child && !is_leaf(child)) {
+    Inner* node = as_inner(child);
+    if (node->terminal) {
+      return node->terminal;
+    }
+    child = first_child_from(node, 0);
+  }
+  return child ? as_leaf(child) : nullptr;
+}
+
+ArtRep::Leaf* ArtRep::max_leaf(Child child) {
+  while (child && !is_leaf(child)) {
+    Inner* node = as_inner(child);
+    Child  last = last_child(node);
+    if (last == 0) {
+      return node->terminal;
+    }
+    child = last;
+  }
+  return child ? as_leaf(child) : nullptr;
+}
+
+void ArtRep::add_child(Child& slot, uint8_t byte, Child child) {
+  Inner* node = as_inner(slot);
+  switch (node->type) {
+    case kNode4: {
+      auto* n = static_cast<Node4*>(node);
+      if (n->count < 4) {
+        insert_sorted_child(n, byte, child);
+        return;
+      }
+      // 子节点满了, 换成更大的节点类型
+      auto* grown = new Node16();
+      move_header(n, grown);
+      std::copy(n->keys, n->keys + 4, grown->keys);
+      std::copy(n->children, n->children + 4, grown->children);
+      grown->count = 4;
+      insert_sorted_child(grown, byte, child);
+      inner_bytes += sizeof(Node16);
+      inner_bytes -= sizeof(Node4);
+      delete n;
+      slot = reinterpret_cast<Child>(static_cast<Inner*>(grown));
+      return;
+    }
+    case kNode16: {
+      auto* n = static_cast<Node16*>(node);
+      if (n->count < 16) {
+        insert_sorted_child(n, byte, child);
+        return;
+      }
+      auto* grown = new Node48();
+      move_header(n, grown);
+      for (int i = 0; i < 16; ++i) {
+        grown->children[i]       = n->children[i];
+        grown->index[n->keys[i]] = static_cast<uint8_t>(i + 1);
+      }
+      grown->children[16] = child;
+      grown->index[byte]  = 17;
+      grown->count        = 17;
+      inner_bytes += sizeof(Node48);
+      inner_bytes -= sizeof(Node16);
+      delete n;
+      slot = reinterpret_cast<Child>(static_cast<Inner*>(grown));
+      return;
+    }
+    case kNode48: {
+      auto* n = static_cast<Node48*>(node);
+      if (n->count < 48) {
+        int pos = 0;
+        while (n->children[pos]) {
+          ++pos;
+        }
+        n->children[pos] = child;
+        n->index[byte]   = static_cast<uint8_t>(pos + 1);
+        n->count++;
+        return;
+      }
+      auto* grown = new Node256();
+      move_header(n, grown);
+      for (int b = 0; b < 256; ++b) {
+        if (n->index[b]) {
+          grown->children[b] = n->children[n->index[b] - 1];
+        }
+      }
+      grown->children[byte] = child;
+      grown->count          = 49;
+      inner_bytes += sizeof(Node256);
+      inner_bytes -= sizeof(Node48);
+      delete n;
+      slot = reinterpret_cast<Child>(static_cast<Inner*>(grown));
+      return;
+    }
+    default: {
+      auto* n           = static_cast<Node256*>(node);
+      n->children[byte] = child;
+      n->count++;
+      return;
+    }
+  }
+}
+
+ArtRep::Leaf* ArtRep::new_leaf(Node* node) {
+  char* mem = arena_->allocate_aligned(sizeof(Leaf));
+  return new (mem) Leaf{node->key_, node, node};
+}
+
+std::pair<ArtRep::Leaf*, bool> ArtRep::insert_leaf(Child& slot, std::string_view key,
+                                                   std::size_t depth, Node* node) {
+  if (slot == 0) {
+    Leaf* leaf = new_leaf(node);
+    slot       = leaf_child(leaf);
+    return {leaf, true};
+  }
+  if (is_leaf(slot)) {
+    Leaf* existing = as_leaf(slot);
+    if (existing->key == key) {
+      return {existing, false};
+    }
+    // 两个 key 在 depth 之后的公共部分成为新内部节点的压缩路径
+    std::size_t common = common_prefix_length(existing->key.substr(depth), key.substr(depth));
+    auto*       inner  = new Node4();
+    inner_bytes += sizeof(Node4);
+    inner->prefix = std::string(key.substr(depth, common));
+    std::size_t split = depth + common;
+    Child       old   = slot;
+    slot              = reinterpret_cast<Child>(static_cast<Inner*>(inner));
+    if (existing->key.size() == split) {
+      inner->terminal = existing;
+    } else {
+      add_child(slot, existing->key[split], old);
+    }
+    Leaf* leaf = new_leaf(node);
+    if (key.size() == split) {
+      inner->terminal = leaf;
+    } else {
+      add_child(slot, key[split], leaf_child(leaf));
+    }
+    return {leaf, true};
+  }
+
+  Inner*           inner  = as_inner(slot);
+  std::string_view rest   = key.substr(depth);
+  std::size_t      common = common_prefix_length(inner->prefix, rest);
+  if (common < inner->prefix.size()) {
+    // 压缩路径在 common 处分叉, 拆出一个新的父节点
+    auto* parent = new Node4();
+    inner_bytes += sizeof(Node4);
+    parent->prefix = inner->prefix.substr(0, common);
+    uint8_t byte   = inner->prefix[common];
+    inner->prefix.erase(0, common + 1);
+    Child old = slot;
+    slot      = reinterpret_cast<Child>(static_cast<Inner*>(parent));
+    add_child(slot, byte, old);
+    Leaf* leaf = new_leaf(node);
+    if (rest.size() == common) {
+      parent->terminal = leaf;
+    } else {
+      add_child(slot, rest[common], leaf_child(leaf));
+    }
+    return {leaf, true};
+  }
+  depth += inner->prefix.size();
+  if (key.size() == depth) {
+    if (inner->terminal) {
+      return {inner->terminal, false};
+    }
+    inner->terminal = new_leaf(node);
+    return {inner->terminal, true};
+  }
+  Child* child = find_child(inner, key[depth]);
+  if (child) {
+    return insert_leaf(*child, key, depth + 1, node);
+  }
+  Leaf* leaf = new_leaf(node);
+  add_child(slot, key[depth], leaf_child(leaf));
+  return {leaf, true};
+}
+
+ArtRep::Leaf* ArtRep::find_leaf(std::string_view key) const {
+  Child       child = root_;
+  std::size_t depth = 0;
+  while (child) {
+    if (is_leaf(child)) {
+      Leaf* leaf = as_leaf(child);
+      return leaf->key == key ? leaf : nullptr;
+    }
+    Inner* inner = as_inner(child);
+    if (!key.substr(depth).starts_with(inner->prefix)) {
+      return nullptr;
+    }
+    depth += inner->prefix.size();
+    if (depth == key.size()) {
+      return inner->terminal;
+    }
+    Child* next = find_child(inner, key[depth]);
+    if (next == nullptr) {
+      return nullptr;
+    }
+    child = *next;
+    depth++;
+  }
+  return nullptr;
+}
+
+ArtRep::Leaf* ArtRep::lower_bound(Child child, std::string_view key, std::size_t depth) const {
+  if (child == 0) {
+    return nullptr;
+  }
+  if (is_leaf(child)) {
+    Leaf* leaf = as_leaf(child);
+    return leaf->key >= key ? leaf : nullptr;
+  }
+  Inner*           inner = as_inner(child);
+  std::string_view rest  = key.substr(depth);
+  std::size_t      i     = common_prefix_length(inner->prefix, rest);
+  if (i < inner->prefix.size()) {
+    // 压缩路径与 key 不同: 路径更大(或 key 已经结束)时整棵子树都 >= key, 否则都 < key
+    if (i == rest.size() ||
+        static_cast<uint8_t>(inner->prefix[i]) > static_cast<uint8_t>(rest[i])) {
+      return min_leaf(child);
+    }
+    return nullptr;
+  }
+  depth += inner->prefix.size();
+  if (depth == key.size()) {
+    return min_leaf(child);
+  }
+  // terminal 是 key 的真前缀, 比 key 小, 跳过
+  uint8_t byte = key[depth];
+  if (Child* next = find_child(inner, byte)) {
+    if (Leaf* leaf = lower_bound(*next, key, depth + 1)) {
+      return leaf;
+    }
+  }
+  Child sibling = first_child_from(inner, byte + 1);
+  return sibling ? min_leaf(sibling) : nullptr;
+}
+
+Node* ArtRep::first_visible(Leaf* leaf, uint64_t transaction_id) {
+  uint64_t visible = transaction_id == 0 ? UINT64_MAX : transaction_id;
+  for (Node* node = leaf->first;; node = node->next(0)) {
+    if (node->transaction_id <= visible) {
+      return node;
+    }
+    if (node == leaf->last) {
+      return nullptr;
+    }
+  }
+}
+
+bool ArtRep::Insert(const std::string& key, const std::string& value, uint64_t transaction_id) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  // 一次下降得到第一个 >= key 的叶子: 相等时是已有的 key, 否则是新 key 在链表中的后继
+  Leaf* successor = lower_bound(root_, key, 0);
+  if (successor && successor->key == key) {
+    // 在该 key 的版本中按 transaction_id 降序找到位置, 同一版本的新值排在旧值之前
+    Leaf* leaf   = successor;
+    Node* prev   = leaf->prev ? leaf->prev->last : head;
+    Node* next   = leaf->first;
+    bool  at_end = false;
+    while (next->transaction_id > transaction_id) {
+      prev = next;
+      if (next == leaf->last) {
+        at_end = true;
+        break;
+      }
+      next = next->next(0);
+    }
+    if (!at_end && next->transaction_id == transaction_id && next->value_ == value) {
+      return false;  // 同一版本已经存在相同的值
+    }
+    Node* node = Node::create(*arena_, key, value, 1, transaction_id, false);
+    node->no_barrier_set_next(0, prev->no_barrier_next(0));
+    prev->set_next(0, node);
+    if (next == leaf->first && !at_end) {
+      leaf->first = node;
+    }
+    if (at_end) {
+      leaf->last = node;
+    }
+  } else {
+    Node* node     = Node::create(*arena_, key, value, 1, transaction_id, false);
+    auto [leaf, _] = insert_leaf(root_, node->key_, 0, node);
+    leaf->next     = successor;
+    leaf->prev     = successor ? successor->prev : leaf_tail_;
+    if (leaf->prev) {
+      leaf->prev->next = leaf;
+    }
+    if (successor) {
+      successor->prev = leaf;
+    } else {
+      leaf_tail_ = leaf;
+    }
+    Node* prev = leaf->prev ? leaf->prev->last : head;
+    node->no_barrier_set_next(0, prev->no_barrier_next(0));
+    prev->set_next(0, node);
+  }
+  size_bytes += key.size() + value.size();
+  return true;
+}
+
+bool ArtRep::InsertConcurrently(const std::string& key, const std::string& value,
+                                uint64_t transaction_id) {
+  // 树的修改由写锁串行化
+  return Insert(key, value, transaction_id);
+}
+
+Node* ArtRep::Get(const std::string& key, uint64_t transaction_id) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  Leaf*                               leaf = find_leaf(key);
+  return leaf ? first_visible(leaf, transaction_id) : nullptr;
+}
+
+SkiplistIterator ArtRep::get_iterator(const std::string& key, uint64_t transaction_id) {
+  return SkiplistIterator(Get(key, transaction_id), arena_, head);
+}
+
+std::pair<SkiplistIterator, SkiplistIterator> ArtRep::prefix_range(const std::string& key,
+                                                                   uint64_t transaction_id) {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  // 沿前缀下降, 找到所有 key 都以它开头的最小子树
+  Child       subtree = 0;
+  Child       child   = root_;
+  std::size_t depth   = 0;
+  while (child) {
+    if (is_leaf(child)) {
+      if (as_leaf(child)->key.starts_with(key)) {
+        subtree = child;
+      }
+      break;
+    }
+    Inner*           inner = as_inner(child);
+    std::string_view rest  = std::string_view(key).substr(depth);
+    std::size_t      n     = std::min(rest.size(), inner->prefix.size());
+    if (rest.substr(0, n) != std::string_view(inner->prefix).substr(0, n)) {
+      break;
+    }
+    if (rest.size() <= inner->prefix.size()) {
+      subtree = child;
+      break;
+    }
+    depth += inner->prefix.size();
+    Child* next = find_child(inner, key[depth]);
+    if (next == nullptr) {
+      break;
+    }
+    child = *next;
+    depth++;
+  }
+  if (subtree == 0) {
+    return {end(), end()};
+  }
+  Leaf* first = min_leaf(subtree);
+  Leaf* last  = max_leaf(subtree);
+  Node* begin = first->first;
+  if (first->key == key) {
+    // 与前缀完全相同的 key 跳过对该快照不可见的新版本
+    Node* visible = first_visible(first, transaction_id);
+    begin         = visible ? visible : first->last->next(0);
+  }
+  return {SkiplistIterator(begin, arena_, head),
+          SkiplistIterator(last->last->next(0), arena_, head)};
+}
+
+std::shared_ptr<Skiplist> ArtRep::sorted_view() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::string_view                    common;
+  if (root_) {
+    std::string_view first = min_leaf(root_)->key;
+    common                 = first.substr(0, common_prefix_length(first, max_leaf(root_)->key));
+  }
+  // 链表已经有序, 用插入位置提示依次追加; 同一版本被重复写入时只保留链表中在前的新值
+  auto             table = std::make_shared<Skiplist>(MAX_LEVEL, common);
+  Skiplist::Splice splice;
+  Node*            prev = nullptr;
+  for (Node* node = head->next(0); node; node = node->next(0)) {
+    if (prev && prev->transaction_id == node->transaction_id && prev->key_ == node->key_) {
+      continue;
+    }
+    table->InsertHint(std::string(node->key_), std::string(node->value_), node->transaction_id,
+                      splice);
+    prev = node;
+  }
+  return table;
+}
+
+std::size_t ArtRep::get_size() {
+  return size_bytes;
+}
+
+std::size_t ArtRep::memory_usage() const {
+  return arena_->memory_usage() + inner_bytes.load(std::memory_order_relaxed);
+}
+
+SkiplistIterator ArtRep::begin() {
+  return SkiplistIterator(head->next(0), arena_, head);
+}
+
+SkiplistIterator ArtRep::end() {
+  return SkiplistIterator(nullptr, arena_, head);
+}
+
+SkiplistIterator ArtRep::prefix_serach_begin(const std::string& key, uint64_t transaction_id) {
+  return prefix_range(key, transaction_id).first;
+}
+
+SkiplistIterator ArtRep::prefix_serach_end(const std::string& key, uint64_t transaction_id) {
+  return prefix_range(key, transaction_id).second;
+}
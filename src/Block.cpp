@@ -1,5 +1,10 @@
 #include "../include/Block.h"
 #include "../include/BlockIterator.h"
+#include "../include/Compression.h"
+#include "../include/Crc32c.h"
+#include "../include/Global.h"
+#include "../include/Varint.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -8,284 +13,776 @@
 #include <print>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 
-class BlockIterator;
-Block::Block(std::size_t capacity) : capcity(capacity) {}
-Block::Block() : capcity(4096) {
-  // 默认构造函数，初始化容量为4096
+namespace {
+// v2 尾部的格式标记, 写在 v1 存条目数的位置; v1 的块不可能有 0xffff 个条目
+constexpr uint16_t kFormatTag = 0xffff;
+// v2 尾部的版本. 2: 校验和固定为 std::hash; 3: 版本前多一个字节记录校验和类型
+constexpr uint8_t kTrailerVersionHash     = 2;
+constexpr uint8_t kTrailerVersionChecksum = 3;
+// v2 尾部: 条目数(uint32_t) + 重启间隔(uint16_t) + 校验和类型(uint8_t) + 版本(uint8_t)
+// + 格式标记(uint16_t); 版本 2 没有校验和类型
+constexpr size_t kV2TrailerSize = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t) +
+                                  sizeof(uint8_t) + sizeof(uint16_t);
+// 压缩块: 压缩后的原始块(不带校验和) + 原始大小(uint32_t) + 压缩算法(uint8_t)
+// + 校验和类型(uint8_t) + 版本 4(uint8_t) + 格式标记(uint16_t), 校验和覆盖压缩后的数据
+constexpr uint8_t kTrailerVersionCompressed = 4;
+constexpr size_t  kCompressedTrailerSize =
+    sizeof(uint32_t) + sizeof(uint8_t) * 3 + sizeof(uint16_t);
+
+// 版本 5: 与版本 3 相同, 重启点数组之后多一个哈希索引: 桶(uint8_t × n) + 桶数(uint16_t)
+constexpr uint8_t kTrailerVersionHashIndex = 5;
+// 哈希索引的桶记录 key 所在的重启点; 不同重启点的 key 落在同一个桶时记为冲突
+constexpr uint8_t kHashBucketCollision = 254;
+constexpr uint8_t kHashBucketEmpty     = 255;
+
+uint32_t key_hash(std::string_view key) {
+  return crc32c(key.data(), key.size());
 }
 
-std::vector<uint8_t> Block::encode(bool with_hash) {
-  // Data_ + offsets(uint16_t) + num(uint16_t) [+ hash(uint32_t)]
-  size_t offsets_bytes = Offset_.size() * sizeof(uint16_t);
-  size_t total         = Data_.size() * sizeof(uint8_t) + offsets_bytes + sizeof(uint16_t) +
-                 (with_hash ? sizeof(uint32_t) : 0);
-  std::vector<uint8_t> encoded(total, 0);
+// v3 条目格式的尾部, 版本 6: 基准事务id(uint64_t) + 条目数(uint32_t) + 重启间隔(uint16_t)
+// + 标志(uint8_t) + 校验和类型(uint8_t) + 版本(uint8_t) + 格式标记(uint16_t);
+// 标志中有 kHasHashIndex 时哈希索引在重启点数组和尾部之间, 与版本 5 相同
+constexpr uint8_t kTrailerVersionV3 = 6;
+constexpr uint8_t kHasHashIndex     = 1;
+constexpr size_t  kV3TrailerSize    = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t) +
+                                   sizeof(uint8_t) * 3 + sizeof(uint16_t);
+
+// 校验和在 [data, data + size) 之后
+void check_block_checksum(Global_::ChecksumType type, const uint8_t* data, size_t size) {
+  uint32_t checksum;
+  memcpy(&checksum, data + size, sizeof(uint32_t));
+  if (checksum != compute_checksum(type, data, size)) {
+    throw std::runtime_error("Block checksum verification failed");
+  }
+}
+}  // namespace
 
-  std::memcpy(encoded.data(), Data_.data(), Data_.size() * sizeof(uint8_t));
+class BlockIterator;
+Block::Block(std::size_t capacity, Format format)
+    : capcity(capacity),
+      format_(format),
+      checksum_type_(format == Format::kV1 ? Global_::ChecksumType::kStdHash
+                                           : Global_::ChecksumType::kCrc32c),
+      restart_interval_(format == Format::kV1 ? 1 : Global_::BLOCK_RESTART_INTERVAL) {}
+Block::Block() : Block(4096) {
+  // 默认构造函数，初始化容量为4096
+}
 
-  // write offsets as uint16_t (explicit conversion + check)
-  size_t off_pos = Data_.size() * sizeof(uint8_t);
-  memcpy(encoded.data() + off_pos, Offset_.data(), Offset_.size() * sizeof(uint16_t));
+std::vector<uint8_t> Block::encode(bool with_checksum, Global_::CompressionType compression,
+                                   bool with_hash_index) {
+  // v1: Data_ + offsets(uint16_t) + num(uint16_t) [+ hash(uint32_t)], 校验和固定为 std::hash
+  // v2: Data_ + restarts(uint32_t) + [buckets(uint8_t) + num_buckets(uint16_t)] + num(uint32_t)
+  //     + interval(uint16_t) + checksum_type(uint8_t) + version(uint8_t) + tag(uint16_t)
+  //     [+ checksum(uint32_t)]
+  // v3: Data_ + restarts(uint32_t) + [buckets(uint8_t) + num_buckets(uint16_t)]
+  //     + base_tranc_id(uint64_t) + num(uint32_t) + interval(uint16_t) + flags(uint8_t)
+  //     + checksum_type(uint8_t) + version(uint8_t) + tag(uint16_t) [+ checksum(uint32_t)]
+  std::vector<uint8_t> buckets;
+  if (with_hash_index && format_ != Format::kV1) {
+    buckets = build_hash_index();
+  }
+  size_t               index_size = buckets.empty() ? 0 : buckets.size() + sizeof(uint16_t);
+  std::vector<uint8_t> encoded(get_cur_size() + index_size, 0);
+  std::memcpy(encoded.data(), data(), data_size() * sizeof(uint8_t));
+  uint8_t* ptr = encoded.data() + data_size();
+
+  if (format_ == Format::kV1) {
+    // write offsets as uint16_t (explicit conversion + check)
+    for (size_t i = 0; i < num_restarts(); ++i) {
+      uint16_t offset16 = restart_offset(i);
+      memcpy(ptr, &offset16, sizeof(uint16_t));
+      ptr += sizeof(uint16_t);
+    }
+    // write num elements
+    uint16_t num_elements = num_restarts();
+    memcpy(ptr, &num_elements, sizeof(uint16_t));
+  } else {
+    for (size_t i = 0; i < num_restarts(); ++i) {
+      uint32_t offset = restart_offset(i);
+      memcpy(ptr, &offset, sizeof(uint32_t));
+      ptr += sizeof(uint32_t);
+    }
+    if (!buckets.empty()) {
+      memcpy(ptr, buckets.data(), buckets.size());
+      ptr += buckets.size();
+      uint16_t num_buckets = buckets.size();
+      memcpy(ptr, &num_buckets, sizeof(uint16_t));
+      ptr += sizeof(uint16_t);
+    }
+    if (format_ == Format::kV3) {
+      memcpy(ptr, &base_tranc_id_, sizeof(uint64_t));
+      ptr += sizeof(uint64_t);
+    }
+    memcpy(ptr, &num_entries_, sizeof(uint32_t));
+    ptr += sizeof(uint32_t);
+    memcpy(ptr, &restart_interval_, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+    if (format_ == Format::kV3) {
+      *ptr++ = buckets.empty() ? 0 : kHasHashIndex;
+    }
+    *ptr++ = static_cast<uint8_t>(checksum_type_);
+    if (format_ == Format::kV3) {
+      *ptr++ = kTrailerVersionV3;
+    } else {
+      *ptr++ = buckets.empty() ? kTrailerVersionChecksum : kTrailerVersionHashIndex;
+    }
+    memcpy(ptr, &kFormatTag, sizeof(uint16_t));
+  }
 
-  // write num elements
-  size_t   num_pos      = Data_.size() * sizeof(uint8_t) + Offset_.size() * sizeof(uint16_t);
-  uint16_t num_elements = Offset_.size();
-  memcpy(encoded.data() + num_pos, &num_elements, sizeof(uint16_t));
+  // 压缩整个块, 节省不到 COMPRESSION_MIN_SAVING_PERCENT 时仍存原始块
+  auto checksum_type = checksum_type_;
+  if (compression != Global_::CompressionType::kNone) {
+    std::vector<uint8_t> compressed;
+    if (compress(compression, encoded.data(), encoded.size(), compressed)) {
+      size_t   pos      = compressed.size();
+      uint32_t raw_size = encoded.size();
+      compressed.resize(pos + kCompressedTrailerSize);
+      memcpy(compressed.data() + pos, &raw_size, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      compressed[pos++] = static_cast<uint8_t>(compression);
+      compressed[pos++] = static_cast<uint8_t>(Global_::ChecksumType::kCrc32c);
+      compressed[pos++] = kTrailerVersionCompressed;
+      memcpy(compressed.data() + pos, &kFormatTag, sizeof(uint16_t));
+      if (compressed.size() * 100 <=
+          encoded.size() * (100 - Global_::COMPRESSION_MIN_SAVING_PERCENT)) {
+        encoded       = std::move(compressed);
+        checksum_type = Global_::ChecksumType::kCrc32c;
+      }
+    }
+  }
 
-  // write hash if needed (hash over everything before hash)
-  if (with_hash) {
-    uint32_t hash_value = std::hash<std::string_view>{}(std::string_view(
-        reinterpret_cast<const char*>(encoded.data()), encoded.size() - sizeof(uint32_t)));
-    std::memcpy(encoded.data() + encoded.size() - sizeof(uint32_t), &hash_value, sizeof(uint32_t));
+  // 校验和覆盖它前面的所有字节
+  if (with_checksum) {
+    uint32_t checksum = compute_checksum(checksum_type, encoded.data(), encoded.size());
+    encoded.resize(encoded.size() + sizeof(uint32_t));
+    std::memcpy(encoded.data() + encoded.size() - sizeof(uint32_t), &checksum, sizeof(uint32_t));
   }
   return encoded;
 }
 
-std::shared_ptr<Block> Block::decode(const std::vector<uint8_t>& encoded, bool with_hash) {
+std::shared_ptr<Block> Block::decode(const std::vector<uint8_t>& encoded, bool with_checksum,
+                                     bool verify_checksum) {
+  return decode(std::vector<uint8_t>(encoded), with_checksum, verify_checksum);
+}
+
+std::shared_ptr<Block> Block::decode(std::vector<uint8_t>&& encoded, bool with_checksum,
+                                     bool verify_checksum) {
+  // 接管读出的缓冲区, 不再复制
+  auto buffer = std::make_shared<const std::vector<uint8_t>>(std::move(encoded));
+  return decode(buffer, buffer->data(), buffer->size(), with_checksum, verify_checksum);
+}
+
+std::shared_ptr<Block> Block::decode(std::shared_ptr<const void> owner, const uint8_t* encoded,
+                                     size_t size, bool with_checksum, bool verify_checksum) {
   // 使用 make_shared 创建对象
   auto block = std::make_shared<Block>();
 
   // 1. 安全性检查
-  if (with_hash && encoded.size() <= sizeof(uint16_t) + sizeof(uint32_t)) {
+  if (with_checksum && size <= sizeof(uint16_t) + sizeof(uint32_t)) {
+    throw std::runtime_error("Encoded data too small");
+  }
+  size_t checksum_size = with_checksum ? sizeof(uint32_t) : 0;
+  if (size < sizeof(uint16_t) + checksum_size) {
     throw std::runtime_error("Encoded data too small");
   }
 
-  // 2. 读取元素个数
-  uint16_t num_elements;
-  size_t   num_elements_pos = encoded.size() - sizeof(uint16_t);
-  if (with_hash) {
-    num_elements_pos -= sizeof(uint32_t);
-    auto     hash_pos = encoded.size() - sizeof(uint32_t);
-    uint32_t hash_value;
-    memcpy(&hash_value, encoded.data() + hash_pos, sizeof(uint32_t));
+  // 2. 读取条目数, v2 在同一位置写的是格式标记
+  size_t   tail = size - checksum_size - sizeof(uint16_t);
+  uint16_t num_or_tag;
+  memcpy(&num_or_tag, encoded + tail, sizeof(uint16_t));
 
-    uint32_t compute_hash = std::hash<std::string_view>{}(std::string_view(
-        reinterpret_cast<const char*>(encoded.data()), encoded.size() - sizeof(uint32_t)));
-    if (hash_value != compute_hash) {
-      throw std::runtime_error("Block hash verification failed");
+  size_t data_size;
+  if (num_or_tag != kFormatTag) {
+    // 3. v1: 每个条目一个 uint16_t 偏移
+    if (tail < num_or_tag * sizeof(uint16_t)) {
+      throw std::runtime_error("Block offsets out of range");
+    }
+    data_size                 = tail - num_or_tag * sizeof(uint16_t);
+    block->format_            = Format::kV1;
+    block->checksum_type_     = Global_::ChecksumType::kStdHash;
+    block->restart_interval_  = 1;
+    block->num_entries_       = num_or_tag;
+    block->view_num_restarts_ = num_or_tag;
+  } else {
+    // 3. v2: 读取尾部, 重启点的个数由条目数和间隔算出
+    if (tail < sizeof(uint8_t)) {
+      throw std::runtime_error("Block trailer too small");
+    }
+    auto version = encoded[tail - sizeof(uint8_t)];
+    if (version == kTrailerVersionCompressed) {
+      // 压缩块: 先校验压缩后的数据, 再解压出不带校验和的原始块
+      if (tail + sizeof(uint16_t) < kCompressedTrailerSize) {
+        throw std::runtime_error("Block trailer too small");
+      }
+      size_t   trailer_start = tail + sizeof(uint16_t) - kCompressedTrailerSize;
+      uint32_t raw_size;
+      memcpy(&raw_size, encoded + trailer_start, sizeof(uint32_t));
+      auto compression   = static_cast<Global_::CompressionType>(encoded[trailer_start + 4]);
+      auto checksum_type = static_cast<Global_::ChecksumType>(encoded[trailer_start + 5]);
+      if (with_checksum && verify_checksum) {
+        check_block_checksum(checksum_type, encoded, size - sizeof(uint32_t));
+      }
+      auto raw_block = decode(decompress(compression, encoded, trailer_start, raw_size), false);
+      raw_block->compression_ = compression;
+      return raw_block;
+    }
+    size_t trailer_size;
+    bool   hash_index = false;
+    switch (version) {
+      case kTrailerVersionHash:
+        trailer_size = kV2TrailerSize - sizeof(uint8_t);
+        break;
+      case kTrailerVersionChecksum:
+        trailer_size = kV2TrailerSize;
+        break;
+      case kTrailerVersionHashIndex:
+        trailer_size = kV2TrailerSize;
+        hash_index   = true;
+        break;
+      case kTrailerVersionV3:
+        trailer_size = kV3TrailerSize;
+        break;
+      default:
+        throw std::runtime_error("Unsupported block format");
+    }
+    if (tail + sizeof(uint16_t) < trailer_size) {
+      throw std::runtime_error("Block trailer too small");
+    }
+    size_t trailer_start = tail + sizeof(uint16_t) - trailer_size;
+    size_t field         = trailer_start;
+    block->format_       = Format::kV2;
+    if (version == kTrailerVersionV3) {
+      block->format_ = Format::kV3;
+      memcpy(&block->base_tranc_id_, encoded + field, sizeof(uint64_t));
+      field += sizeof(uint64_t);
+      hash_index = (encoded[tail - sizeof(uint8_t) * 3] & kHasHashIndex) != 0;
+    }
+    if (version == kTrailerVersionHash) {
+      block->checksum_type_ = Global_::ChecksumType::kStdHash;
+    } else {
+      block->checksum_type_ =
+          static_cast<Global_::ChecksumType>(encoded[tail - sizeof(uint8_t) * 2]);
+    }
+    memcpy(&block->num_entries_, encoded + field, sizeof(uint32_t));
+    memcpy(&block->restart_interval_, encoded + field + sizeof(uint32_t), sizeof(uint16_t));
+    if (block->restart_interval_ == 0) {
+      throw std::runtime_error("Invalid block restart interval");
     }
+    size_t num_restarts =
+        (block->num_entries_ + block->restart_interval_ - 1) / block->restart_interval_;
+    size_t restarts_end = trailer_start;
+    if (hash_index) {
+      // 哈希索引在重启点数组和尾部之间
+      uint16_t num_buckets;
+      if (restarts_end < sizeof(uint16_t)) {
+        throw std::runtime_error("Block hash index out of range");
+      }
+      memcpy(&num_buckets, encoded + restarts_end - sizeof(uint16_t), sizeof(uint16_t));
+      if (num_buckets == 0 || restarts_end < sizeof(uint16_t) + num_buckets) {
+        throw std::runtime_error("Block hash index out of range");
+      }
+      restarts_end -= sizeof(uint16_t) + num_buckets;
+      block->view_hash_buckets_ = encoded + restarts_end;
+      block->view_num_buckets_  = num_buckets;
+    }
+    if (restarts_end < num_restarts * sizeof(uint32_t)) {
+      throw std::runtime_error("Block offsets out of range");
+    }
+    data_size                 = restarts_end - num_restarts * sizeof(uint32_t);
+    block->view_num_restarts_ = num_restarts;
   }
-  memcpy(&num_elements, encoded.data() + num_elements_pos, sizeof(uint16_t));
 
-  // 4. 计算各段位置
-  size_t offsets_section_start = num_elements_pos - num_elements * sizeof(uint16_t);
+  // 校验和覆盖它前面的所有字节; 调用方已经校验过的数据可以跳过
+  if (with_checksum && verify_checksum) {
+    check_block_checksum(block->checksum_type_, encoded, size - sizeof(uint32_t));
+  }
 
-  // 5. 读取偏移数组
-  block->Offset_.resize(num_elements);
-  memcpy(block->Offset_.data(), encoded.data() + offsets_section_start,
-         num_elements * sizeof(uint16_t));
+  // 4. 条目区和重启点数组都留在原缓冲区中
+  block->buffer_        = std::move(owner);
+  block->view_data_     = encoded;
+  block->view_size_     = data_size;
+  block->view_restarts_ = encoded + data_size;
+  for (size_t i = 0; i < block->view_num_restarts_; ++i) {
+    if (block->restart_offset(i) >= data_size) {
+      throw std::runtime_error("Block offsets out of range");
+    }
+  }
+  return block;
+}
 
-  // 6. 复制数据段
-  block->Data_.reserve(offsets_section_start);  // 优化内存分配
-  block->Data_.assign(encoded.begin(), encoded.begin() + offsets_section_start);
+const uint8_t* Block::data() const {
+  return buffer_ ? view_data_ : Data_.data();
+}
 
-  return block;
+size_t Block::data_size() const {
+  return buffer_ ? view_size_ : Data_.size();
+}
+
+size_t Block::num_restarts() const {
+  return buffer_ ? view_num_restarts_ : Offset_.size();
 }
 
-// safe get_key/get_value/get_tranc_id with bounds checks
-std::string Block::get_key(const std::size_t offset) const {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    std::print("Invaild offset to much");
+uint32_t Block::restart_offset(std::size_t restart) const {
+  if (!buffer_) {
+    return Offset_[restart];
   }
-  uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
-  return std::string(reinterpret_cast<const char*>(Data_.data() + offset + sizeof(uint16_t)),
-                     key_len);
+  // 编码中的偏移可能没有对齐, 用 memcpy 读取
+  if (format_ == Format::kV1) {
+    uint16_t offset;
+    memcpy(&offset, view_restarts_ + restart * sizeof(uint16_t), sizeof(uint16_t));
+    return offset;
+  }
+  uint32_t offset;
+  memcpy(&offset, view_restarts_ + restart * sizeof(uint32_t), sizeof(uint32_t));
+  return offset;
 }
 
-std::string Block::get_value(const std::size_t offset) const {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    std::print("Invaild offset to much");
+Block::Entry Block::parse_entry(const std::size_t offset) const {
+  if (offset >= data_size()) {
+    throw std::out_of_range("Block entry offset out of range");
   }
+  Entry          entry{};
+  const uint8_t* ptr = data() + offset;
+  if (format_ == Format::kV3) {
+    // [shared][unshared_len][value_len][unshared key][value][tranc_id 与基准的差值],
+    // 除 key 和 value 外都是变长整数
+    const uint8_t* limit = data() + data_size();
+    uint64_t       shared, unshared_len, value_size, delta;
+    ptr = get_varint(ptr, limit, &shared);
+    ptr = ptr ? get_varint(ptr, limit, &unshared_len) : nullptr;
+    ptr = ptr ? get_varint(ptr, limit, &value_size) : nullptr;
+    if (ptr == nullptr || unshared_len + value_size > static_cast<size_t>(limit - ptr)) {
+      throw std::out_of_range("Block entry out of range");
+    }
+    entry.shared   = shared;
+    entry.unshared = std::string_view(reinterpret_cast<const char*>(ptr), unshared_len);
+    ptr += unshared_len;
+    entry.value = std::string_view(reinterpret_cast<const char*>(ptr), value_size);
+    ptr += value_size;
+    ptr = get_varint(ptr, limit, &delta);
+    if (ptr == nullptr) {
+      throw std::out_of_range("Block entry out of range");
+    }
+    entry.tranc_id = base_tranc_id_ + zigzag_decode(delta);
+    entry.next     = ptr - data();
+    return entry;
+  }
+  uint16_t shared16;
   uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
   uint16_t value_len;
-  std::memcpy(&value_len, Data_.data() + offset + sizeof(uint16_t) + key_len, sizeof(uint16_t));
-  return std::string(reinterpret_cast<const char*>(Data_.data() + offset + sizeof(uint16_t) +
-                                                   key_len + sizeof(uint16_t)),
-                     value_len);
+  if (format_ == Format::kV1) {
+    // [key_len][key][value_len][value][tranc_id]
+    std::memcpy(&key_len, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+    entry.unshared = std::string_view(reinterpret_cast<const char*>(ptr), key_len);
+    ptr += key_len;
+    std::memcpy(&value_len, ptr, sizeof(uint16_t));
+    ptr += sizeof(uint16_t);
+  } else {
+    // [shared][unshared_len][value_len][unshared key][value][tranc_id]
+    std::memcpy(&shared16, ptr, sizeof(uint16_t));
+    std::memcpy(&key_len, ptr + sizeof(uint16_t), sizeof(uint16_t));
+    std::memcpy(&value_len, ptr + sizeof(uint16_t) * 2, sizeof(uint16_t));
+    ptr += sizeof(uint16_t) * 3;
+    entry.shared   = shared16;
+    entry.unshared = std::string_view(reinterpret_cast<const char*>(ptr), key_len);
+    ptr += key_len;
+  }
+  entry.value = std::string_view(reinterpret_cast<const char*>(ptr), value_len);
+  ptr += value_len;
+  std::memcpy(&entry.tranc_id, ptr, sizeof(uint64_t));
+  entry.next = ptr + sizeof(uint64_t) - data();
+  return entry;
 }
-std::shared_ptr<Block::Entry> Block::get_entry(std::size_t offset) {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    std::print("Invaild offset to much");
+
+void Block::cursor_seek(Cursor& cursor, std::size_t index) const {
+  if (index >= num_entries_) {
+    cursor.index      = index;
+    cursor.offset     = data_size();
+    cursor.key_in_buf = false;
+    return;
+  }
+  size_t restart = index / restart_interval_;
+  cursor.index   = restart * restart_interval_;
+  cursor.offset  = restart_offset(restart);
+  cursor_load(cursor);
+  while (cursor.index < index) {
+    cursor_next(cursor);
   }
-  auto key      = get_key(offset);
-  auto value    = get_value(offset);
-  auto tranc_id = get_tranc_id(offset);
-  return std::make_shared<Block::Entry>(Block::Entry{key, value, tranc_id.value()});
 }
 
-std::optional<uint64_t> Block::get_tranc_id(const std::size_t offset) const {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    std::print("Invaild offset to much");
+void Block::cursor_next(Cursor& cursor) const {
+  cursor.offset = parse_entry(cursor.offset).next;
+  ++cursor.index;
+  if (cursor.index < num_entries_) {
+    cursor_load(cursor);
+  } else {
+    cursor.key_in_buf = false;
   }
-  uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
-  size_t   pos = offset + sizeof(uint16_t) + key_len;
-  uint16_t value_len;
-  std::memcpy(&value_len, Data_.data() + pos, sizeof(uint16_t));
-  pos += sizeof(uint16_t) + value_len;
-  uint64_t tr;
-  std::memcpy(&tr, Data_.data() + pos, sizeof(uint64_t));
-  return tr;
 }
-std::string Block::get_first_key() {
-  if (Offset_.empty()) {
-    return "";
+
+void Block::cursor_load(Cursor& cursor) const {
+  if (format_ == Format::kV1) {
+    return;  // key 总是完整存储的
+  }
+  auto entry = parse_entry(cursor.offset);
+  if (entry.shared == 0) {
+    cursor.key_buf.assign(entry.unshared);
+    cursor.key_in_buf = false;
+  } else {
+    cursor.key_buf.resize(entry.shared);
+    cursor.key_buf.append(entry.unshared);
+    cursor.key_in_buf = true;
   }
-  return get_key(Offset_[0]);
 }
 
-std::optional<size_t> Block::get_idx_binary(const std::string& key, uint64_t tranc_id) {
-  if (Offset_.empty()) {
-    return std::nullopt;
+std::string_view Block::cursor_key(const Cursor& cursor) const {
+  if (cursor.key_in_buf) {
+    return cursor.key_buf;
+  }
+  return parse_entry(cursor.offset).unshared;
+}
+
+Block::Position Block::restart_position(std::size_t restart, std::string_view key) const {
+  Position pos;
+  pos.index      = restart * restart_interval_;
+  pos.offset     = restart_offset(restart);
+  auto entry_key = parse_entry(pos.offset).unshared;
+  pos.match =
+      std::mismatch(entry_key.begin(), entry_key.end(), key.begin(), key.end()).first -
+      entry_key.begin();
+  int result = entry_key.compare(key);
+  pos.cmp    = result < 0 ? -1 : (result > 0 ? 1 : 0);
+  return pos;
+}
+
+void Block::advance(Position& pos, std::string_view key) const {
+  pos.offset = parse_entry(pos.offset).next;
+  ++pos.index;
+  if (pos.index >= num_entries_) {
+    return;
   }
-  // 二分查找
-  int left  = 0;
-  int right = Offset_.size();
+  if (pos.index % restart_interval_ == 0) {
+    // 重启点的 shared 总是 0, 不能用来推断, 直接比较完整的 key
+    pos = restart_position(pos.index / restart_interval_, key);
+    return;
+  }
+  // 条目有序: 与上一条共享 shared 个字节, 之后的字节大于上一条
+  auto entry = parse_entry(pos.offset);
+  if (pos.cmp == 0) {
+    // 上一条等于 key: 本条只有在没有多余字节时才仍然等于 key, 否则更大
+    pos.match = entry.shared;
+    pos.cmp   = entry.shared == key.size() && entry.unshared.empty() ? 0 : 1;
+  } else if (pos.cmp > 0) {
+    // 上一条已经大于 key, 本条也大于 key
+    pos.match = std::min<size_t>(pos.match, entry.shared);
+  } else if (entry.shared < pos.match) {
+    // 上一条小于 key 且前 match 个字节与 key 相同, 本条在更早的位置变大, 所以大于 key
+    pos.match = entry.shared;
+    pos.cmp   = 1;
+  } else if (entry.shared == pos.match) {
+    // 从分歧处继续比较剩余的字节
+    auto   rest = key.substr(pos.match);
+    size_t same = std::mismatch(entry.unshared.begin(), entry.unshared.end(), rest.begin(),
+                                rest.end())
+                      .first -
+                  entry.unshared.begin();
+    pos.match += same;
+    int result = entry.unshared.substr(same).compare(rest.substr(same));
+    pos.cmp    = result < 0 ? -1 : (result > 0 ? 1 : 0);
+  }
+  // entry.shared > pos.match: 本条在同一位置与 key 分歧, 仍然小于 key
+}
+
+Block::Position Block::lower_bound(std::string_view key, uint64_t tranc_id) const {
+  // (条目的 key, tranc_id) 是否排在 (key, tranc_id) 之前
+  auto before = [&](const Position& pos) {
+    return pos.cmp < 0 || (pos.cmp == 0 && parse_entry(pos.offset).tranc_id > tranc_id);
+  };
+  // 二分找到第一个不在目标之前的重启点, 目标在它之前的区间里或者就是它
+  size_t left  = 0;
+  size_t right = num_restarts();
   while (left < right) {
-    int         mid     = left + (right - left) / 2;
-    std::string mid_key = get_key(Offset_[mid]);
-    if (mid_key == key && get_tranc_id(Offset_[mid]).value() <= tranc_id) {
-      return mid;
-    } else if (mid_key < key) {
+    size_t mid = left + (right - left) / 2;
+    if (before(restart_position(mid, key))) {
       left = mid + 1;
     } else {
-      right = mid - 1;
+      right = mid;
     }
   }
-  if (left < Offset_.size()) {
-    if (get_key(Offset_[left]) == key && get_tranc_id(Offset_[left]).value() <= tranc_id) {
-      return left;
+  if (left == 0) {
+    if (num_entries_ == 0) {
+      return Position{0, data_size(), 0, 1};
     }
-  } else {
-    if (get_key(Offset_[left - 1]) == key && get_tranc_id(Offset_[left]).value() <= tranc_id) {
-      return left - 1;
+    return restart_position(0, key);
+  }
+  auto   pos = restart_position(left - 1, key);
+  size_t end = std::min<size_t>(left * restart_interval_, num_entries_);
+  while (pos.index < end && before(pos)) {
+    advance(pos, key);
+  }
+  return pos;
+}
+
+std::vector<uint8_t> Block::build_hash_index() const {
+  // 桶里只能存 254 以下的重启点编号
+  if (num_entries_ == 0 || num_restarts() >= kHashBucketCollision) {
+    return {};
+  }
+  // 同一 key 的多个版本只在第一次出现时计数
+  std::vector<std::pair<uint32_t, uint8_t>> keys;
+  Cursor                                    cursor;
+  std::string                               last;
+  for (cursor_seek(cursor, 0); cursor.index < num_entries_; cursor_next(cursor)) {
+    auto key = cursor_key(cursor);
+    if (cursor.index == 0 || key != last) {
+      keys.emplace_back(key_hash(key), cursor.index / restart_interval_);
+      last.assign(key);
     }
   }
-  // 如果没有找到完全匹配的键，返回 std::nullopt
-  return std::nullopt;
+  auto   wanted      = static_cast<size_t>(keys.size() / Global_::BLOCK_HASH_INDEX_UTIL_RATIO);
+  size_t num_buckets = std::min<size_t>(wanted + 1, UINT16_MAX);
+  std::vector<uint8_t> buckets(num_buckets, kHashBucketEmpty);
+  for (auto [hash, restart] : keys) {
+    auto& bucket = buckets[hash % num_buckets];
+    if (bucket == kHashBucketEmpty) {
+      bucket = restart;
+    } else if (bucket != restart) {
+      bucket = kHashBucketCollision;
+    }
+  }
+  return buckets;
 }
 
-std::optional<size_t> Block::get_prefix_begin_idx_binary(const std::string& key,
-                                                         uint64_t           tranc_id) {
-  if (Offset_.empty())
+std::optional<Block::Position> Block::hash_seek(std::string_view key, uint64_t tranc_id) const {
+  if (view_num_buckets_ == 0) {
     return std::nullopt;
+  }
+  uint8_t bucket = view_hash_buckets_[key_hash(key) % view_num_buckets_];
+  if (bucket == kHashBucketCollision) {
+    return std::nullopt;
+  }
+  Position missing{num_entries_, data_size(), 0, 1};
+  if (bucket >= num_restarts()) {
+    return missing;
+  }
+  // key 第一次出现一定在 bucket 所指的区间里
+  auto   pos = restart_position(bucket, key);
+  size_t end = std::min<size_t>((bucket + 1) * restart_interval_, num_entries_);
+  while (pos.cmp < 0 && pos.index + 1 < end) {
+    advance(pos, key);
+  }
+  if (pos.cmp != 0) {
+    return missing;
+  }
+  // 同一 key 的版本按 tranc_id 降序排列, 可能延续到后面的区间
+  while (pos.index < num_entries_ && pos.cmp == 0 && parse_entry(pos.offset).tranc_id > tranc_id) {
+    advance(pos, key);
+  }
+  return pos;
+}
 
-  // 优先检查完全匹配（并传入 tranc_id）
-  auto exact = get_idx_binary(key, tranc_id);
-  if (exact.has_value())
-    return exact.value();
+Block::Position Block::point_seek(std::string_view key, uint64_t tranc_id) const {
+  if (auto pos = hash_seek(key, tranc_id)) {
+    return *pos;
+  }
+  return lower_bound(key, tranc_id);
+}
 
-  // 二分查找插入点（第一个 >= key）
-  int left  = 0;
-  int right = Offset_.size();
-  while (left < right) {
-    int         mid     = left + (right - left) / 2;
-    std::string mid_key = get_key(Offset_[mid]);
-    if (mid_key < key) {
-      left = mid + 1;
-    } else {
-      right = mid;
-    }
+void Block::cursor_at(Cursor& cursor, const Position& pos, std::string_view key) const {
+  cursor.index  = pos.index;
+  cursor.offset = pos.offset;
+  if (format_ != Format::kV1) {
+    cursor.key_buf.assign(key);
+    cursor.key_in_buf = parse_entry(pos.offset).shared != 0;
   }
-  if (left < Offset_.size()) {
-    if (get_key(Offset_[left]).starts_with(key) &&
-        get_tranc_id(Offset_[left]).value() <= tranc_id) {
-      return left;
-    }
-  } else {
-    if (get_key(Offset_[left - 1]).starts_with(key) &&
-        get_tranc_id(Offset_[left - 1]).value() <= tranc_id) {
-      return left - 1;
-    }
+}
+
+std::optional<uint64_t> Block::get_tranc_id(const std::size_t offset) const {
+  return parse_entry(offset).tranc_id;
+}
+std::string Block::get_first_key() {
+  if (num_entries_ == 0) {
+    return "";
+  }
+  return std::string(parse_entry(restart_offset(0)).unshared);
+}
+
+std::optional<size_t> Block::get_idx_binary(std::string_view key, uint64_t tranc_id) {
+  auto pos = point_seek(key, tranc_id);
+  if (pos.index < num_entries_ && pos.cmp == 0) {
+    return pos.index;
   }
+  // 如果没有找到完全匹配的键，返回 std::nullopt
   return std::nullopt;
 }
 
-std::optional<size_t> Block::get_prefix_end_idx_binary(const std::string& key, uint64_t tranc_id) {
-  if (Offset_.empty()) {
-    return std::nullopt;
+std::optional<size_t> Block::get_prefix_begin_idx_binary(std::string_view key, uint64_t tranc_id) {
+  // 第一个以 key 开头且 tranc_id 可见的条目; 等于 key 的不可见版本已被 lower_bound 跳过,
+  // 更长的 key 的不可见版本在这里跳过
+  auto pos = lower_bound(key, tranc_id);
+  while (pos.index < num_entries_ && pos.match == key.size() &&
+         parse_entry(pos.offset).tranc_id > tranc_id) {
+    advance(pos, key);
+  }
+  if (pos.index < num_entries_ && pos.match == key.size()) {
+    return pos.index;
   }
-  const std::string want = key + '\xff';
-  // 优先检查完全匹配（并传入 tranc_id）
-  auto exact = get_idx_binary(want, tranc_id);
-  if (exact.has_value())
-    return exact.value() + 1;
-  // 二分查找插入点：找到最后一个匹配前缀的位置
-  // 查找策略：找到第一个 >= want 的位置，然后往前找一个匹配前缀的位置
-  int left  = 0;
-  int right = Offset_.size();
+  return std::nullopt;
+}
+
+std::optional<size_t> Block::get_prefix_end_idx_binary(std::string_view key, uint64_t tranc_id) {
+  // 二分找到第一个 key 大于前缀范围的重启点, 再从它之前的区间往前找最后一个可见的条目
+  size_t left  = 0;
+  size_t right = num_restarts();
   while (left < right) {
-    int         mid     = left + (right - left) / 2;
-    std::string mid_key = get_key(Offset_[mid]);
-
-    // 如果 mid_key 匹配前缀，继续往后找（可能有更多匹配的）
-    if (mid_key.starts_with(key)) {
-      if (get_tranc_id(Offset_[mid]).value() <= tranc_id) {
-        left = mid + 1;  // 继续往后找
-      } else {
-        // 事务ID不符合，往前找
-        right = mid;
-      }
-    } else if (mid_key < want) {
-      // mid_key 小于 want，说明匹配前缀的项可能在后面
+    size_t mid = left + (right - left) / 2;
+    auto   pos = restart_position(mid, key);
+    if (pos.cmp < 0 || pos.match == key.size()) {
       left = mid + 1;
     } else {
-      // mid_key >= want，说明匹配前缀的项在前面
       right = mid;
     }
   }
-
-  // 现在 left 指向第一个不匹配前缀的位置
-  // 需要往前找最后一个匹配前缀的位置
-  if (left > 0) {
-    left--;  // 往前移动一个位置
-    if (get_key(Offset_[left]).starts_with(key) &&
-        get_tranc_id(Offset_[left]).value() <= tranc_id) {
-      return left + 1;  // 返回最后一个匹配位置 + 1
+  for (size_t restart = left; restart-- > 0;) {
+    auto                  pos = restart_position(restart, key);
+    size_t                end = std::min<size_t>((restart + 1) * restart_interval_, num_entries_);
+    bool                  before_range = pos.cmp < 0 && pos.match < key.size();
+    std::optional<size_t> last;
+    for (; pos.index < end; advance(pos, key)) {
+      if (pos.match == key.size() && parse_entry(pos.offset).tranc_id <= tranc_id) {
+        last = pos.index + 1;
+      }
+    }
+    if (last.has_value()) {
+      return last;
+    }
+    if (before_range) {
+      break;  // 更早的区间都小于前缀
     }
-  }
-  if (get_key(Offset_[left]).starts_with(key) && get_tranc_id(Offset_[left]).value() <= tranc_id) {
-    return left + 1;
   }
   return std::nullopt;
 }
 std::optional<size_t> Block::get_offset(const std::size_t index) {
-  if (index >= Offset_.size()) {
+  if (index >= num_entries_) {
     throw std::out_of_range("Index out of range");
   }
-  return Offset_[index];
+  Cursor cursor;
+  cursor_seek(cursor, index);
+  return cursor.offset;
 }
 size_t Block::get_cur_size() const {
-  return Data_.size() + Offset_.size() * sizeof(uint16_t) + sizeof(uint16_t);
+  if (format_ == Format::kV1) {
+    return data_size() + num_restarts() * sizeof(uint16_t) + sizeof(uint16_t);
+  }
+  if (format_ == Format::kV3) {
+    return data_size() + num_restarts() * sizeof(uint32_t) + kV3TrailerSize;
+  }
+  return data_size() + num_restarts() * sizeof(uint32_t) + kV2TrailerSize;
+}
+Block::Format Block::format() const {
+  return format_;
+}
+Global_::ChecksumType Block::checksum_type() const {
+  return checksum_type_;
+}
+Global_::CompressionType Block::compression_type() const {
+  return compression_;
+}
+bool Block::has_hash_index() const {
+  return view_num_buckets_ != 0;
+}
+std::size_t Block::num_entries() const {
+  return num_entries_;
 }
 
-std::optional<std::string> Block::get_value_binary(const std::string& key) {
-  auto idx = get_idx_binary(key);
-  if (idx.has_value()) {
-    return get_value(Offset_[idx.value()]);
+std::optional<std::string> Block::get_value_binary(std::string_view key) {
+  auto pos = point_seek(key, 0);
+  if (pos.index < num_entries_ && pos.cmp == 0) {
+    return std::string(parse_entry(pos.offset).value);
   }
   return std::nullopt;
 }
 
-bool Block::KeyExists(const std::string& key) {
+bool Block::KeyExists(std::string_view key) {
   auto idx = get_idx_binary(key);
   return idx.has_value();
 }
 
 std::pair<std::string, std::string> Block::get_first_and_last_key() {
-  if (Offset_.empty()) {
+  if (num_entries_ == 0) {
     return {"", ""};
   }
-  std::string first_key = get_key(Offset_[0]);
-  std::string last_key  = get_key(Offset_[Offset_.size() - 1]);
-  return {first_key, last_key};
+  Cursor cursor;
+  cursor_seek(cursor, num_entries_ - 1);
+  return {get_first_key(), std::string(cursor_key(cursor))};
 }
 bool Block::add_entry(const std::string& key, const std::string& value, uint64_t tranc_id,
                       bool force_write) {
+  if (buffer_) {
+    throw std::logic_error("Cannot add entries to a decoded block");
+  }
+  if (format_ != Format::kV1) {
+    // 每个区间的第一个条目是重启点, 存完整的 key; 其余条目只存与上一条不同的后缀
+    bool   restart = num_entries_ % restart_interval_ == 0;
+    size_t shared  = 0;
+    if (!restart) {
+      size_t limit = std::min(last_key_.size(), key.size());
+      while (shared < limit && last_key_[shared] == key[shared]) {
+        ++shared;
+      }
+    }
+    size_t unshared = key.size() - shared;
+    // v3 的 tranc_id 存与第一个条目的差值, 同一块中的事务id通常相近
+    if (num_entries_ == 0) {
+      base_tranc_id_ = tranc_id;
+    }
+    uint64_t delta      = zigzag_encode(static_cast<int64_t>(tranc_id - base_tranc_id_));
+    size_t   entry_size = sizeof(uint16_t) * 3 + unshared + value.size() + sizeof(uint64_t);
+    if (format_ == Format::kV3) {
+      entry_size = varint_length(shared) + varint_length(unshared) + varint_length(value.size()) +
+                   unshared + value.size() + varint_length(delta);
+    }
+    if ((!force_write) &&
+        (get_cur_size() + entry_size + (restart ? sizeof(uint32_t) : 0) > capcity) &&
+        num_entries_ != 0) {
+      return false;
+    }
+    size_t old_size = Data_.size();
+    Data_.resize(old_size + entry_size);
+    uint8_t* ptr = Data_.data() + old_size;
+    if (format_ == Format::kV3) {
+      ptr = put_varint(ptr, shared);
+      ptr = put_varint(ptr, unshared);
+      ptr = put_varint(ptr, value.size());
+    } else {
+      uint16_t shared16   = shared;
+      uint16_t unshared16 = unshared;
+      uint16_t value_len  = value.size();
+      memcpy(ptr, &shared16, sizeof(uint16_t));
+      memcpy(ptr + sizeof(uint16_t), &unshared16, sizeof(uint16_t));
+      memcpy(ptr + sizeof(uint16_t) * 2, &value_len, sizeof(uint16_t));
+      ptr += sizeof(uint16_t) * 3;
+    }
+    memcpy(ptr, key.data() + shared, unshared);
+    ptr += unshared;
+    memcpy(ptr, value.data(), value.size());
+    ptr += value.size();
+    if (format_ == Format::kV3) {
+      put_varint(ptr, delta);
+    } else {
+      memcpy(ptr, &tranc_id, sizeof(uint64_t));
+    }
+    if (restart) {
+      Offset_.push_back(old_size);
+    }
+    last_key_ = key;
+    ++num_entries_;
+    return true;
+  }
   if ((!force_write) &&
       (get_cur_size() + key.size() + value.size() + 3 * sizeof(uint16_t) > capcity) &&
       !Offset_.empty()) {
@@ -316,18 +813,19 @@ bool Block::add_entry(const std::string& key, const std::string& value, uint64_t
          &tranc_id, sizeof(uint64_t));
   // 记录偏移
   Offset_.push_back(old_size);
+  ++num_entries_;
   return true;
 }
 bool Block::is_empty() const {
-  return Data_.empty() && Offset_.empty();
+  return num_entries_ == 0 && data_size() == 0;
 }
 
-BlockIterator Block::get_iterator(const std::string& key, uint64_t tranc_id) {
-  auto idx = get_idx_binary(key, tranc_id);
-  if (!idx.has_value()) {
+BlockIterator Block::get_iterator(std::string_view key, uint64_t tranc_id) {
+  BlockIterator iter(shared_from_this(), key, tranc_id);
+  if (iter.is_end()) {
     return end();
   }
-  return BlockIterator(shared_from_this(), idx.value(), tranc_id);
+  return iter;
 }
 BlockIterator Block::begin() {
   auto shared = shared_from_this();
@@ -335,24 +833,24 @@ BlockIterator Block::begin() {
 }
 BlockIterator Block::end() {
   auto shared = shared_from_this();
-  return BlockIterator(shared, Offset_.size(), 0);
+  return BlockIterator(shared, num_entries_, 0);
 }
 
 std::optional<std::pair<std::shared_ptr<BlockIterator>, std::shared_ptr<BlockIterator>>>
-Block::get_prefix_iterator(std::string key, uint64_t tranc_id) {
+Block::get_prefix_iterator(std::string_view key, uint64_t tranc_id) {
   auto result1 = get_prefix_begin_idx_binary(key, tranc_id);
   if (!result1.has_value()) {
     return std::nullopt;
   }
   auto begin = std::make_shared<BlockIterator>(shared_from_this(), result1.value(), tranc_id);
-  if (result1.value() == Offset_.size() - 1) {
-    auto end = std::make_shared<BlockIterator>(shared_from_this(), Offset_.size(), tranc_id, false);
+  if (result1.value() == num_entries_ - 1) {
+    auto end = std::make_shared<BlockIterator>(shared_from_this(), num_entries_, tranc_id, false);
     return std::make_pair(begin, end);
   }
   auto result2 = get_prefix_end_idx_binary(key, tranc_id);
 
-  // 如果找不到 end 索引，使用 Offset_.size() 作为结束位置
-  size_t end_index = result2.has_value() ? result2.value() : Offset_.size();
+  // 如果找不到 end 索引，使用 num_entries_ 作为结束位置
+  size_t end_index = result2.has_value() ? result2.value() : num_entries_;
   auto   end = std::make_shared<BlockIterator>(shared_from_this(), end_index, tranc_id, false);
   return std::make_pair(begin, end);
 }
\ No newline at end of file
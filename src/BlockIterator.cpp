@@ -5,26 +5,31 @@
 #include <utility>
 
 bool operator==(const BlockIterator& lhs, const BlockIterator& rhs) noexcept {
-  return lhs.block == rhs.block && lhs.current_index == rhs.current_index &&
+  return lhs.block == rhs.block && lhs.cursor_.index == rhs.cursor_.index &&
          lhs.tranc_id_ == rhs.tranc_id_;
 }
-BlockIterator::BlockIterator() : block(nullptr), current_index(0), tranc_id_(0) {}
-BlockIterator::BlockIterator(std::shared_ptr<Block> block_, const std::string& key,
+BlockIterator::BlockIterator() : block(nullptr), tranc_id_(0) {}
+BlockIterator::BlockIterator(std::shared_ptr<Block> block_, std::string_view key,
                              uint64_t tranc_id)
     : block(block_), tranc_id_(tranc_id) {  // 初始化为0
   if (!block) {
     return;
   }
-  auto iter = block->get_idx_binary(key, tranc_id);
-  if (iter.has_value()) {
-    current_index = iter.value();
+  auto pos = block->lower_bound(key, tranc_id);
+  if (pos.index < block->num_entries_ && pos.cmp == 0) {
+    block->cursor_at(cursor_, pos, key);
   } else {
-    current_index = block->Offset_.size();
+    block->cursor_seek(cursor_, block->num_entries_);
   }
 }
 BlockIterator::BlockIterator(std::shared_ptr<Block> block_, size_t index, uint64_t tranc_id,
                              bool should_skip)
-    : block(block_), current_index(index), tranc_id_(tranc_id) {
+    : block(block_), tranc_id_(tranc_id) {
+  if (block) {
+    block->cursor_seek(cursor_, index);
+  } else {
+    cursor_.index = index;
+  }
   if (should_skip) {
     skip_by_tranc_id();  // 只在需要时跳过
   }
@@ -32,7 +37,7 @@ BlockIterator::BlockIterator(std::shared_ptr<Block> block_, size_t index, uint64
 
 bool BlockIterator::is_end() {
   if (block) {
-    return current_index >= block->Offset_.size();
+    return cursor_.index >= block->num_entries_;
   }
   return true;
 }
@@ -44,8 +49,8 @@ BlockIterator::con_pointer BlockIterator::operator->() {
   return &(*cached_value);
 }
 BlockIterator& BlockIterator::operator++() {
-  if (block && current_index < block->Offset_.size()) {
-    current_index++;
+  if (block && cursor_.index < block->num_entries_) {
+    block->cursor_next(cursor_);
     update_current();
     skip_by_tranc_id();  // 跳过不可见的事务
   }
@@ -64,32 +69,37 @@ auto BlockIterator::operator<=>(const BlockIterator& other) const -> std::strong
   if (block != other.block) {
     return block <=> other.block;
   }
-  if (current_index != other.current_index) {
-    return current_index <=> other.current_index;
+  if (cursor_.index != other.cursor_.index) {
+    return cursor_.index <=> other.cursor_.index;
   }
   return tranc_id_ <=> other.tranc_id_;
 }
 
 BlockIterator::value_type BlockIterator::getValue() const {
-  if (current_index < 0 || current_index >= block->Offset_.size()) {
+  if (!block || cursor_.index >= block->num_entries_) {
     throw std::out_of_range("Index out of range in BlockIterator");
   }
-  auto offset = block->Offset_[current_index];
-  auto entry  = block->get_entry(offset);
-  return std::make_pair(entry->key, entry->value);
+  return std::make_pair(std::string(key()), std::string(value()));
+}
+std::string_view BlockIterator::key() const {
+  return block->cursor_key(cursor_);
+}
+std::string_view BlockIterator::value() const {
+  return block->parse_entry(cursor_.offset).value;
+}
+uint64_t BlockIterator::tranc_id() const {
+  return block->parse_entry(cursor_.offset).tranc_id;
 }
 size_t BlockIterator::getIndex() const {
-  return current_index;
+  return cursor_.index;
 }
 std::shared_ptr<Block> BlockIterator::get_block() const {
   return block;
 }
 void BlockIterator::update_current() {
   cached_value = std::nullopt;  // 每次都清空缓存
-  if (block && current_index < block->Offset_.size()) {
-    auto offset  = block->Offset_[current_index];
-    auto entry   = block->get_entry(offset);
-    cached_value = std::make_pair(entry->key, entry->value);
+  if (block && cursor_.index < block->num_entries_) {
+    cached_value = std::make_pair(std::string(key()), std::string(value()));
   }
 }
 void BlockIterator::skip_by_tranc_id() {
@@ -97,12 +107,10 @@ void BlockIterator::skip_by_tranc_id() {
     cached_value = std::nullopt;
     return;
   }
-  while (current_index < block->Offset_.size()) {
-    auto offset = block->Offset_[current_index];
-    auto entry  = block->get_entry(offset);
-    if (entry->tranc_id <= tranc_id_) {  // ← 改成 <=（逻辑检查）
+  while (cursor_.index < block->num_entries_) {
+    if (tranc_id() <= tranc_id_) {  // ← 改成 <=（逻辑检查）
       break;
     }
-    ++current_index;
+    block->cursor_next(cursor_);
   }
 }
\ No newline at end of file
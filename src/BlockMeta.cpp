@@ -1,4 +1,5 @@
 #include "../include/BlockMeta.h"
+#include "../include/Crc32c.h"
 #include <cstring>
 #include <stdexcept>
 #include <string_view>
@@ -8,7 +9,8 @@ BlockMeta::BlockMeta() : first_key_(""), last_key_(""), offset_(0) {}
 BlockMeta::BlockMeta(std::string first_key, std::string last_key, size_t offset)
     : first_key_(first_key), last_key_(last_key), offset_(offset) {}
 
-std::vector<uint8_t> BlockMeta::encode_meta_to_slice(std::vector<BlockMeta>& meta) {
+std::vector<uint8_t> BlockMeta::encode_meta_to_slice(std::vector<BlockMeta>& meta,
+                                                     Global_::ChecksumType   checksum_type) {
   size_t               num_meta = meta.size();
   std::vector<uint8_t> slice;
   if (num_meta == 0) {
@@ -43,14 +45,14 @@ std::vector<uint8_t> BlockMeta::encode_meta_to_slice(std::vector<BlockMeta>& met
   uint8_t* hash_start = slice.data() + sizeof(size_t);
   uint8_t* hash_end   = ptr;
   size_t   hash_size  = hash_end - hash_start;  //==data.size();
-  uint32_t hash       = std::hash<std::string_view>{}(
-      std::string_view(reinterpret_cast<const char*>(hash_start), hash_size));
+  uint32_t hash       = compute_checksum(checksum_type, hash_start, hash_size);
   memcpy(ptr, &hash, sizeof(uint32_t));
   ptr += sizeof(uint32_t);
   return slice;
 }
 
-std::vector<BlockMeta> BlockMeta::decode_meta_from_slice(std::vector<uint8_t>& slice) {
+std::vector<BlockMeta> BlockMeta::decode_meta_from_slice(std::vector<uint8_t>& slice,
+                                                       Global_::ChecksumType checksum_type) {
   if (slice.empty()) {
     return {};
   }
@@ -86,8 +88,7 @@ std::vector<BlockMeta> BlockMeta::decode_meta_from_slice(std::vector<uint8_t>& s
   uint8_t* hash_end   = ptr;
   ptr += sizeof(uint32_t);
   size_t   hash_size = hash_end - hash_start;
-  uint32_t hash2     = std::hash<std::string_view>{}(
-      std::string_view(reinterpret_cast<const char*>(hash_start), hash_size));
+  uint32_t hash2     = compute_checksum(checksum_type, hash_start, hash_size);
   if (hash != hash2) {
     throw std::runtime_error("Hash mismatch: data may be corrupted");
   }
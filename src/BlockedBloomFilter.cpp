@@ -0,0 +1,49 @@
+#include "../include/BlockedBloomFilter.h"
+#include <algorithm>
+#include <functional>
+
+BlockedBloomFilter::BlockedBloomFilter(std::size_t expected_keys, int bits_per_key) {
+  std::size_t bits = std::max<std::size_t>(expected_keys * bits_per_key, 512);
+  blocks_.resize((bits + 511) / 512);
+  // 最优探测次数 k = bits_per_key * ln2
+  num_probes_ = std::clamp(static_cast<int>(bits_per_key * 0.69), 1, 12);
+}
+
+uint64_t BlockedBloomFilter::hash(std::string_view key) {
+  return std::hash<std::string_view>{}(key);
+}
+
+std::size_t BlockedBloomFilter::block_index(uint64_t hash) const {
+  return static_cast<std::size_t>((static_cast<unsigned __int128>(hash) * blocks_.size()) >> 64);
+}
+
+void BlockedBloomFilter::add(std::string_view key) {
+  uint64_t h     = hash(key);
+  Block&   block = blocks_[block_index(h)];
+  uint32_t h1    = static_cast<uint32_t>(h);
+  uint32_t delta = (h1 >> 17) | (h1 << 15);
+  for (int i = 0; i < num_probes_; ++i) {
+    uint32_t bit = h1 & 511;
+    block.words[bit >> 6] |= uint64_t{1} << (bit & 63);
+    h1 += delta;
+  }
+}
+
+bool BlockedBloomFilter::possibly_contains(std::string_view key) const {
+  uint64_t     h     = hash(key);
+  const Block& block = blocks_[block_index(h)];
+  uint32_t     h1    = static_cast<uint32_t>(h);
+  uint32_t     delta = (h1 >> 17) | (h1 << 15);
+  for (int i = 0; i < num_probes_; ++i) {
+    uint32_t bit = h1 & 511;
+    if ((block.words[bit >> 6] & (uint64_t{1} << (bit & 63))) == 0) {
+      return false;
+    }
+    h1 += delta;
+  }
+  return true;
+}
+
+std::size_t BlockedBloomFilter::memory_usage() const {
+  return blocks_.size() * sizeof(Block);
+}
@@ -0,0 +1,256 @@
+#include "../include/Checkpoint.h"
+#include "../include/Crc32c.h"
+#include "../include/Skiplist.h"
+#include "../include/mmap.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr uint32_t    kMagic      = 0x4C534D43;  // "LSMC"
+constexpr uint32_t    kVersion    = 1;
+constexpr std::size_t kEntryFixed = sizeof(uint64_t) + sizeof(uint32_t) * 2;
+constexpr std::size_t kIndexEntry = sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2;
+constexpr std::size_t kFooterSize = sizeof(uint32_t) * 5 + sizeof(uint64_t);
+
+struct ChunkInfo {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t entries;
+  uint32_t crc;
+};
+
+template <typename T>
+void put_fixed(std::vector<uint8_t>& out, T value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T get_fixed(const uint8_t* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+// 只追加写的文件, 出错时抛出异常
+class CheckpointWriter {
+ public:
+  explicit CheckpointWriter(const std::string& path) : path_(path) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+      throw std::runtime_error("Failed to create checkpoint: " + path + ": " +
+                               std::strerror(errno));
+    }
+  }
+  ~CheckpointWriter() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  void append(const std::vector<uint8_t>& buf) {
+    std::size_t written = 0;
+    while (written < buf.size()) {
+      ssize_t n = ::write(fd_, buf.data() + written, buf.size() - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        throw std::runtime_error("Failed to write checkpoint: " + path_);
+      }
+      written += static_cast<std::size_t>(n);
+    }
+    offset_ += buf.size();
+  }
+
+  void sync_and_close() {
+    int fd = fd_;
+    fd_    = -1;
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+      throw std::runtime_error("Failed to sync checkpoint: " + path_);
+    }
+  }
+
+  uint64_t offset() const { return offset_; }
+
+ private:
+  std::string path_;
+  int         fd_     = -1;
+  uint64_t    offset_ = 0;
+};
+}  // namespace
+
+void Checkpoint::write(const std::string& path, Skiplist& table) {
+  std::string      tmp_path = path + ".tmp";
+  CheckpointWriter writer(tmp_path);
+
+  std::vector<ChunkInfo> chunks;
+  std::vector<uint8_t>   chunk;
+  uint32_t               chunk_entries = 0;
+  uint64_t               total_entries = 0;
+
+  auto finish_chunk = [&] {
+    if (chunk.empty()) {
+      return;
+    }
+    uint32_t crc = crc32c(chunk.data(), chunk.size());
+    chunks.push_back(ChunkInfo{writer.offset(), chunk.size(), chunk_entries, crc});
+    writer.append(chunk);
+    chunk.clear();
+    chunk_entries = 0;
+  };
+  // 跳表迭代器已经跳过了同一版本被覆盖的旧值
+  for (auto it = table.begin(); it.valid(); ++it) {
+    std::string_view key   = it.key();
+    std::string_view value = it.value();
+    put_fixed<uint64_t>(chunk, it.getseq());
+    put_fixed<uint32_t>(chunk, static_cast<uint32_t>(key.size()));
+    put_fixed<uint32_t>(chunk, static_cast<uint32_t>(value.size()));
+    chunk.insert(chunk.end(), key.begin(), key.end());
+    chunk.insert(chunk.end(), value.begin(), value.end());
+    chunk_entries++;
+    total_entries++;
+    if (chunk.size() >= static_cast<std::size_t>(Global_::CHECKPOINT_CHUNK_BYTES)) {
+      finish_chunk();
+    }
+  }
+  finish_chunk();
+
+  std::string          prefix = table.key_common_prefix();
+  std::vector<uint8_t> tail(prefix.begin(), prefix.end());
+  for (const auto& info : chunks) {
+    put_fixed<uint64_t>(tail, info.offset);
+    put_fixed<uint64_t>(tail, info.size);
+    put_fixed<uint32_t>(tail, info.entries);
+    put_fixed<uint32_t>(tail, info.crc);
+  }
+  put_fixed<uint32_t>(tail, static_cast<uint32_t>(prefix.size()));
+  put_fixed<uint32_t>(tail, static_cast<uint32_t>(chunks.size()));
+  put_fixed<uint32_t>(tail, crc32c(tail.data(), tail.size()));
+  put_fixed<uint64_t>(tail, total_entries);
+  put_fixed<uint32_t>(tail, kVersion);
+  put_fixed<uint32_t>(tail, kMagic);
+  writer.append(tail);
+  writer.sync_and_close();
+
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error("Failed to rename checkpoint: " + path);
+  }
+}
+
+std::shared_ptr<Skiplist> Checkpoint::load(const std::string& path) {
+  MmapFile file;
+  if (!file.open(path)) {
+    throw std::runtime_error("Failed to open checkpoint: " + path);
+  }
+  const auto* data = static_cast<const uint8_t*>(file.data());
+  std::size_t size = file.size();
+  if (size < kFooterSize) {
+    throw std::runtime_error("Checkpoint too small: " + path);
+  }
+
+  const uint8_t* footer        = data + size - kFooterSize;
+  uint32_t       prefix_len    = get_fixed<uint32_t>(footer);
+  uint32_t       chunk_count   = get_fixed<uint32_t>(footer + 4);
+  uint32_t       tail_crc      = get_fixed<uint32_t>(footer + 8);
+  uint64_t       total_entries = get_fixed<uint64_t>(footer + 12);
+  uint32_t       version       = get_fixed<uint32_t>(footer + 20);
+  uint32_t       magic         = get_fixed<uint32_t>(footer + 24);
+  if (magic != kMagic || version != kVersion) {
+    throw std::runtime_error("Bad checkpoint header: " + path);
+  }
+  std::size_t tail_size = prefix_len + static_cast<std::size_t>(chunk_count) * kIndexEntry;
+  if (tail_size > size - kFooterSize) {
+    throw std::runtime_error("Corrupted checkpoint index: " + path);
+  }
+  const uint8_t* tail = footer - tail_size;
+  if (crc32c(tail, tail_size + sizeof(uint32_t) * 2) != tail_crc) {
+    throw std::runtime_error("Corrupted checkpoint index: " + path);
+  }
+
+  std::vector<ChunkInfo> chunks(chunk_count);
+  const uint8_t*         index = tail + prefix_len;
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    const uint8_t* entry = index + i * kIndexEntry;
+    chunks[i] = ChunkInfo{get_fixed<uint64_t>(entry), get_fixed<uint64_t>(entry + 8),
+                          get_fixed<uint32_t>(entry + 16), get_fixed<uint32_t>(entry + 20)};
+    if (chunks[i].offset + chunks[i].size > static_cast<uint64_t>(tail - data)) {
+      throw std::runtime_error("Corrupted checkpoint index: " + path);
+    }
+  }
+
+  auto table = std::make_shared<Skiplist>(
+      MAX_LEVEL, std::string_view(reinterpret_cast<const char*>(tail), prefix_len));
+
+  // 每个线程负责若干个块: 校验 crc, 解析记录并在 Arena 中并发分配节点
+  std::vector<std::vector<Node*>> nodes(chunk_count);
+  std::vector<std::exception_ptr> errors(chunk_count);
+
+  auto parse_chunk = [&](uint32_t c) {
+    const ChunkInfo& info  = chunks[c];
+    const uint8_t*   begin = data + info.offset;
+    if (crc32c(begin, info.size) != info.crc) {
+      throw std::runtime_error("Checkpoint chunk checksum mismatch: " + path);
+    }
+    nodes[c].reserve(info.entries);
+    std::size_t offset = 0;
+    for (uint32_t e = 0; e < info.entries; ++e) {
+      if (offset + kEntryFixed > info.size) {
+        throw std::runtime_error("Corrupted checkpoint chunk: " + path);
+      }
+      uint64_t tranc_id  = get_fixed<uint64_t>(begin + offset);
+      uint32_t key_len   = get_fixed<uint32_t>(begin + offset + 8);
+      uint32_t value_len = get_fixed<uint32_t>(begin + offset + 12);
+      offset += kEntryFixed;
+      if (offset + key_len + value_len > info.size) {
+        throw std::runtime_error("Corrupted checkpoint chunk: " + path);
+      }
+      const char* key = reinterpret_cast<const char*>(begin + offset);
+      nodes[c].push_back(table->AllocateNode(std::string_view(key, key_len),
+                                             std::string_view(key + key_len, value_len), tranc_id));
+      offset += key_len + value_len;
+    }
+  };
+  uint32_t thread_count =
+      std::min<uint32_t>(chunk_count, std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&, t] {
+      for (uint32_t c = t; c < chunk_count; c += thread_count) {
+        try {
+          parse_chunk(c);
+        } catch (...) {
+          errors[c] = std::current_exception();
+          return;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  // 块按顺序排列, 依次追加到表尾即可
+  uint64_t linked = 0;
+  for (const auto& chunk_nodes : nodes) {
+    table->AppendSorted(chunk_nodes);
+    linked += chunk_nodes.size();
+  }
+  if (linked != total_entries) {
+    throw std::runtime_error("Checkpoint entry count mismatch: " + path);
+  }
+  return table;
+}
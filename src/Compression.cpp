@@ -0,0 +1,258 @@
+#include "../include/Compression.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(LSM_HAVE_LZ4)
+#include <lz4.h>
+#endif
+#if defined(LSM_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace {
+// 内置 LZ 压缩的格式是一串序列, 每个序列:
+//   token(uint8_t): 高 4 位是字面量长度, 低 4 位是匹配长度 - kMinMatch, 取 15 时后面跟扩展长度
+//   [字面量长度扩展][字面量][offset(uint16_t)][匹配长度扩展]
+// 扩展长度是若干个 255 加一个小于 255 的字节. 最后一个序列只有字面量, 没有 offset
+constexpr std::size_t kMinMatch    = 4;
+constexpr std::size_t kMaxOffset   = 0xffff;
+constexpr int         kHashBits    = 12;
+constexpr uint32_t    kLengthLimit = 15;
+
+uint32_t load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(uint32_t));
+  return v;
+}
+
+uint32_t hash32(uint32_t v) {
+  return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+void put_length(std::vector<uint8_t>& out, std::size_t len) {
+  for (; len >= 255; len -= 255) {
+    out.push_back(255);
+  }
+  out.push_back(static_cast<uint8_t>(len));
+}
+
+void put_sequence(std::vector<uint8_t>& out, const uint8_t* literals, std::size_t literal_len,
+                  std::size_t offset, std::size_t match_len) {
+  std::size_t match_code = match_len == 0 ? 0 : match_len - kMinMatch;
+  std::size_t high       = std::min<std::size_t>(literal_len, kLengthLimit);
+  std::size_t low        = std::min<std::size_t>(match_code, kLengthLimit);
+  out.push_back(static_cast<uint8_t>(high << 4 | low));
+  if (literal_len >= kLengthLimit) {
+    put_length(out, literal_len - kLengthLimit);
+  }
+  out.insert(out.end(), literals, literals + literal_len);
+  if (match_len == 0) {
+    return;
+  }
+  out.push_back(static_cast<uint8_t>(offset));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (match_code >= kLengthLimit) {
+    put_length(out, match_code - kLengthLimit);
+  }
+}
+
+void lz_compress(const uint8_t* data, std::size_t size, std::vector<uint8_t>& out) {
+  // 哈希表记录每个 4 字节序列最近出现的位置 + 1, 0 表示没有出现过
+  std::array<uint32_t, 1 << kHashBits> table{};
+  std::size_t                          anchor = 0;
+  std::size_t                          pos    = 0;
+  std::size_t                          misses = 0;
+  while (pos + kMinMatch <= size) {
+    uint32_t    seq       = load32(data + pos);
+    auto&       slot      = table[hash32(seq)];
+    std::size_t candidate = slot;
+    slot                  = static_cast<uint32_t>(pos + 1);
+    if (candidate == 0 || pos + 1 - candidate > kMaxOffset || load32(data + candidate - 1) != seq) {
+      // 连续找不到匹配时加大步长, 不可压缩的数据很快扫过
+      pos += 1 + (misses++ >> 5);
+      continue;
+    }
+    std::size_t match = candidate - 1;
+    std::size_t len   = kMinMatch;
+    while (pos + len < size && data[match + len] == data[pos + len]) {
+      ++len;
+    }
+    put_sequence(out, data + anchor, pos - anchor, pos - match, len);
+    pos += len;
+    anchor = pos;
+    misses = 0;
+  }
+  put_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+std::size_t get_length(const uint8_t*& p, const uint8_t* end) {
+  std::size_t len = 0;
+  uint8_t     byte;
+  do {
+    if (p == end) {
+      throw std::runtime_error("Corrupted compressed block");
+    }
+    byte = *p++;
+    len += byte;
+  } while (byte == 255);
+  return len;
+}
+
+std::vector<uint8_t> lz_decompress(const uint8_t* data, std::size_t size, std::size_t raw_size) {
+  std::vector<uint8_t> out;
+  out.reserve(raw_size);
+  const uint8_t* p   = data;
+  const uint8_t* end = data + size;
+  while (p < end) {
+    uint8_t     token       = *p++;
+    std::size_t literal_len = token >> 4;
+    if (literal_len == kLengthLimit) {
+      literal_len += get_length(p, end);
+    }
+    if (literal_len > static_cast<std::size_t>(end - p) || out.size() + literal_len > raw_size) {
+      throw std::runtime_error("Corrupted compressed block");
+    }
+    out.insert(out.end(), p, p + literal_len);
+    p += literal_len;
+    if (p == end) {
+      break;  // 最后一个序列
+    }
+    if (end - p < 2) {
+      throw std::runtime_error("Corrupted compressed block");
+    }
+    std::size_t offset = p[0] | static_cast<std::size_t>(p[1]) << 8;
+    p += 2;
+    std::size_t match_len = (token & 0x0f) + kMinMatch;
+    if ((token & 0x0f) == kLengthLimit) {
+      match_len += get_length(p, end);
+    }
+    if (offset == 0 || offset > out.size() || out.size() + match_len > raw_size) {
+      throw std::runtime_error("Corrupted compressed block");
+    }
+    // 匹配可以和自身重叠, 逐字节复制
+    std::size_t from = out.size() - offset;
+    for (std::size_t i = 0; i < match_len; ++i) {
+      out.push_back(out[from + i]);
+    }
+  }
+  if (out.size() != raw_size) {
+    throw std::runtime_error("Corrupted compressed block");
+  }
+  return out;
+}
+}  // namespace
+
+bool compression_supported(Global_::CompressionType type) {
+  switch (type) {
+    case Global_::CompressionType::kNone:
+    case Global_::CompressionType::kLz:
+      return true;
+    case Global_::CompressionType::kLz4:
+#if defined(LSM_HAVE_LZ4)
+      return true;
+#else
+      return false;
+#endif
+    case Global_::CompressionType::kZstd:
+#if defined(LSM_HAVE_ZSTD)
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+Global_::CompressionType compression_for_level(std::size_t level) {
+  constexpr std::size_t levels = std::size(Global_::LEVEL_COMPRESSION);
+  auto                  type   = Global_::LEVEL_COMPRESSION[std::min(level, levels - 1)];
+  return compression_supported(type) ? type : Global_::CompressionType::kLz;
+}
+
+bool compress(Global_::CompressionType type, const uint8_t* data, std::size_t size,
+              std::vector<uint8_t>& out) {
+  switch (type) {
+    case Global_::CompressionType::kNone:
+      out.insert(out.end(), data, data + size);
+      return true;
+    case Global_::CompressionType::kLz:
+      lz_compress(data, size, out);
+      return true;
+    case Global_::CompressionType::kLz4: {
+#if defined(LSM_HAVE_LZ4)
+      std::size_t start = out.size();
+      out.resize(start + LZ4_compressBound(static_cast<int>(size)));
+      int n = LZ4_compress_default(reinterpret_cast<const char*>(data),
+                                   reinterpret_cast<char*>(out.data() + start),
+                                   static_cast<int>(size), static_cast<int>(out.size() - start));
+      if (n <= 0) {
+        out.resize(start);
+        return false;
+      }
+      out.resize(start + n);
+      return true;
+#else
+      return false;
+#endif
+    }
+    case Global_::CompressionType::kZstd: {
+#if defined(LSM_HAVE_ZSTD)
+      std::size_t start = out.size();
+      out.resize(start + ZSTD_compressBound(size));
+      std::size_t n = ZSTD_compress(out.data() + start, out.size() - start, data, size, 3);
+      if (ZSTD_isError(n)) {
+        out.resize(start);
+        return false;
+      }
+      out.resize(start + n);
+      return true;
+#else
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+std::vector<uint8_t> decompress(Global_::CompressionType type, const uint8_t* data,
+                                std::size_t size, std::size_t raw_size) {
+  switch (type) {
+    case Global_::CompressionType::kNone:
+      if (size != raw_size) {
+        throw std::runtime_error("Corrupted compressed block");
+      }
+      return std::vector<uint8_t>(data, data + size);
+    case Global_::CompressionType::kLz:
+      return lz_decompress(data, size, raw_size);
+    case Global_::CompressionType::kLz4: {
+#if defined(LSM_HAVE_LZ4)
+      std::vector<uint8_t> out(raw_size);
+      int n = LZ4_decompress_safe(reinterpret_cast<const char*>(data),
+                                  reinterpret_cast<char*>(out.data()), static_cast<int>(size),
+                                  static_cast<int>(raw_size));
+      if (n < 0 || static_cast<std::size_t>(n) != raw_size) {
+        throw std::runtime_error("Corrupted compressed block");
+      }
+      return out;
+#else
+      break;
+#endif
+    }
+    case Global_::CompressionType::kZstd: {
+#if defined(LSM_HAVE_ZSTD)
+      std::vector<uint8_t> out(raw_size);
+      std::size_t          n = ZSTD_decompress(out.data(), raw_size, data, size);
+      if (ZSTD_isError(n) || n != raw_size) {
+        throw std::runtime_error("Corrupted compressed block");
+      }
+      return out;
+#else
+      break;
+#endif
+    }
+  }
+  throw std::runtime_error("Unsupported block compression");
+}
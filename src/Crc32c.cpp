@@ -0,0 +1,145 @@
+#include "../include/Crc32c.h"
+#include <array>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define LSM_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define LSM_CRC32C_ARMV8 1
+#endif
+
+namespace {
+// slicing-by-8 的查表: tables[0] 是按字节计算的表, tables[k] 是字节后面再跟 k 个 0 字节的结果
+using Crc32cTables = std::array<std::array<uint32_t, 256>, 8>;
+
+Crc32cTables make_crc32c_tables() {
+  Crc32cTables tables{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0);
+    }
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (size_t k = 1; k < tables.size(); ++k) {
+      uint32_t prev = tables[k - 1][i];
+      tables[k][i]  = (prev >> 8) ^ tables[0][prev & 0xFF];
+    }
+  }
+  return tables;
+}
+
+const Crc32cTables& crc32c_tables() {
+  static const Crc32cTables tables = make_crc32c_tables();
+  return tables;
+}
+
+// 以下实现的 crc 都是取反后的中间状态
+uint32_t crc32c_slicing_by_8(const uint8_t* bytes, std::size_t size, uint32_t crc) {
+  const auto& t = crc32c_tables();
+  // 每次处理 8 个字节, 按小端读取
+  while (size >= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(uint64_t));
+    word ^= crc;
+    crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF] ^
+          t[4][(word >> 24) & 0xFF] ^ t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+          t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+    bytes += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  for (; size > 0; --size) {
+    crc = t[0][(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(LSM_CRC32C_SSE42)
+__attribute__((target("sse4.2"))) uint32_t crc32c_hardware(const uint8_t* bytes,
+                                                            std::size_t size, uint32_t crc) {
+  uint64_t crc64 = crc;
+  while (size >= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(uint64_t));
+    crc64 = _mm_crc32_u64(crc64, word);
+    bytes += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; size > 0; --size) {
+    crc = _mm_crc32_u8(crc, *bytes++);
+  }
+  return crc;
+}
+
+// 编译器没有打开 SSE4.2 时在运行时检查 CPU
+bool hardware_supported() {
+  return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(LSM_CRC32C_ARMV8)
+uint32_t crc32c_hardware(const uint8_t* bytes, std::size_t size, uint32_t crc) {
+  while (size >= sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(uint64_t));
+    crc = __crc32cd(crc, word);
+    bytes += sizeof(uint64_t);
+    size -= sizeof(uint64_t);
+  }
+  for (; size > 0; --size) {
+    crc = __crc32cb(crc, *bytes++);
+  }
+  return crc;
+}
+
+// 编译时打开了 CRC 扩展, 目标 CPU 一定支持
+bool hardware_supported() {
+  return true;
+}
+#endif
+
+using Crc32cImpl = uint32_t (*)(const uint8_t*, std::size_t, uint32_t);
+
+Crc32cImpl select_crc32c() {
+#if defined(LSM_CRC32C_SSE42) || defined(LSM_CRC32C_ARMV8)
+  if (hardware_supported()) {
+    return crc32c_hardware;
+  }
+#endif
+  return crc32c_slicing_by_8;
+}
+
+// 进程内只选择一次实现
+Crc32cImpl crc32c_impl() {
+  static const Crc32cImpl impl = select_crc32c();
+  return impl;
+}
+}  // namespace
+
+uint32_t crc32c(const void* data, std::size_t size, uint32_t crc) {
+  return ~crc32c_impl()(static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+uint32_t crc32c_portable(const void* data, std::size_t size, uint32_t crc) {
+  return ~crc32c_slicing_by_8(static_cast<const uint8_t*>(data), size, ~crc);
+}
+
+bool crc32c_hardware_accelerated() {
+  return crc32c_impl() != crc32c_slicing_by_8;
+}
+
+uint32_t compute_checksum(Global_::ChecksumType type, const void* data, std::size_t size) {
+  switch (type) {
+    case Global_::ChecksumType::kStdHash:
+      return std::hash<std::string_view>{}(
+          std::string_view(static_cast<const char*>(data), size));
+    case Global_::ChecksumType::kCrc32c:
+      return crc32c(data, size);
+  }
+  throw std::runtime_error("Unknown checksum type");
+}
@@ -0,0 +1,229 @@
+#include "../include/MemTableRep.h"
+#include "../include/ArtRep.h"
+#include "../include/PartitionedRep.h"
+#include "../include/Skiplist.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+namespace {
+uint64_t visible_id(uint64_t transaction_id) {
+  return transaction_id == 0 ? UINT64_MAX : transaction_id;
+}
+
+// (key 升序, transaction_id 降序), 与跳表的节点顺序一致
+bool entry_less(const Node* lhs, const Node* rhs) {
+  int cmp = lhs->key_.compare(rhs->key_);
+  return cmp < 0 || (cmp == 0 && lhs->transaction_id > rhs->transaction_id);
+}
+
+// entries 按写入顺序排列, 排序后依次插入新跳表. stable_sort 让同一版本的重复写入保持写入顺序,
+// 跳表会把后写入的排在前面; 有序输入复用同一个插入位置提示, 每次插入接近 O(1)
+std::shared_ptr<Skiplist> build_sorted_skiplist(std::vector<Node*> entries) {
+  std::stable_sort(entries.begin(), entries.end(), entry_less);
+  std::string_view common;
+  if (!entries.empty()) {
+    std::string_view first = entries.front()->key_;
+    std::string_view last  = entries.back()->key_;
+    auto mismatch = std::mismatch(first.begin(), first.end(), last.begin(), last.end());
+    common        = first.substr(0, mismatch.first - first.begin());
+  }
+  auto             table = std::make_shared<Skiplist>(MAX_LEVEL, common);
+  Skiplist::Splice splice;
+  for (const Node* entry : entries) {
+    table->InsertHint(std::string(entry->key_), std::string(entry->value_), entry->transaction_id,
+                      splice);
+  }
+  return table;
+}
+}  // namespace
+
+void MemTableRep::InsertBatch(const std::vector<const std::pair<std::string, std::string>*>& sorted,
+                              uint64_t transaction_id) {
+  for (const auto* pair : sorted) {
+    Insert(pair->first, pair->second, transaction_id);
+  }
+}
+
+void MemTableRep::GetBatch(const std::vector<const std::string*>& sorted, uint64_t transaction_id,
+                           std::vector<Node*>& nodes) {
+  nodes.clear();
+  nodes.reserve(sorted.size());
+  for (const auto* key : sorted) {
+    nodes.push_back(Get(*key, transaction_id));
+  }
+}
+
+std::optional<std::string> MemTableRep::Contain(const std::string& key, uint64_t transaction_id) {
+  Node* node = Get(key, transaction_id);
+  if (node) {
+    return std::string(node->value_);
+  }
+  return std::nullopt;
+}
+
+std::pair<SkiplistIterator, SkiplistIterator> MemTableRep::prefix_range(const std::string& key,
+                                                                       uint64_t transaction_id) {
+  auto table = sorted_view();
+  return {table->prefix_serach_begin(key, transaction_id),
+          table->prefix_serach_end(key, transaction_id)};
+}
+
+std::shared_ptr<MemTableRep> make_memtable_rep(Global_::MemTableRepType type,
+                                               std::string_view         common_prefix) {
+  switch (type) {
+    case Global_::MemTableRepType::kVector:
+      return std::make_shared<VectorRep>();
+    case Global_::MemTableRepType::kHash:
+      return std::make_shared<HashRep>();
+    case Global_::MemTableRepType::kArt:
+      return std::make_shared<ArtRep>();
+    case Global_::MemTableRepType::kPartitioned:
+      return std::make_shared<PartitionedRep>(common_prefix);
+    case Global_::MemTableRepType::kSkiplist:
+    default:
+      return std::make_shared<Skiplist>(MAX_LEVEL, common_prefix);
+  }
+}
+
+std::shared_ptr<Skiplist> SortedViewCache::get(
+    const std::function<std::vector<Node*>()>& collect) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 先读写入次数再收集条目: 收集到的条目至少包含计数覆盖的写入, 多收集的写入只会导致下次重建
+  uint64_t writes = writes_.load(std::memory_order_acquire);
+  if (view_ == nullptr || view_writes_ != writes) {
+    view_        = build_sorted_skiplist(collect());
+    view_writes_ = writes;
+  }
+  return view_;
+}
+
+VectorRep::VectorRep() : arena_(std::make_shared<Arena>()), size_bytes(0) {}
+
+bool VectorRep::Insert(const std::string& key, const std::string& value,
+                       uint64_t transaction_id) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  entries_.push_back(Node::create(*arena_, key, value, 1, transaction_id, false));
+  size_bytes += key.size() + value.size();
+  view_.note_write();
+  return true;
+}
+
+bool VectorRep::InsertConcurrently(const std::string& key, const std::string& value,
+                                   uint64_t transaction_id) {
+  // 追加本身很短, 直接复用互斥锁
+  return Insert(key, value, transaction_id);
+}
+
+Node* VectorRep::Get(const std::string& key, uint64_t transaction_id) {
+  // 数组无序, 从最新写入的条目往前扫描整个数组, 取可见的最大版本;
+  // 同一版本以后写入的为准. 这个表示只适合很少点查的批量导入
+  uint64_t                            visible = visible_id(transaction_id);
+  Node*                               result  = nullptr;
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    Node* entry = *it;
+    if (entry->transaction_id <= visible && entry->key_ == key &&
+        (result == nullptr || entry->transaction_id > result->transaction_id)) {
+      result = entry;
+    }
+  }
+  return result;
+}
+
+SkiplistIterator VectorRep::get_iterator(const std::string& key, uint64_t transaction_id) {
+  // 不带头节点的游标只含这一个条目
+  return SkiplistIterator(Get(key, transaction_id), arena_);
+}
+
+std::shared_ptr<Skiplist> VectorRep::sorted_view() {
+  return view_.get([this] {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return entries_;
+  });
+}
+
+std::size_t VectorRep::get_size() {
+  return size_bytes;
+}
+
+std::size_t VectorRep::memory_usage() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return arena_->memory_usage() + entries_.capacity() * sizeof(Node*);
+}
+
+HashRep::HashRep(std::size_t bucket_count)
+    : arena_(std::make_shared<Arena>()),
+      buckets_(std::make_unique<std::atomic<Node*>[]>(bucket_count)),
+      bucket_count_(bucket_count),
+      size_bytes(0) {
+  for (std::size_t i = 0; i < bucket_count_; ++i) {
+    buckets_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+std::atomic<Node*>& HashRep::bucket(std::string_view key) {
+  return buckets_[std::hash<std::string_view>{}(key) % bucket_count_];
+}
+
+bool HashRep::Insert(const std::string& key, const std::string& value, uint64_t transaction_id) {
+  return InsertConcurrently(key, value, transaction_id);
+}
+
+bool HashRep::InsertConcurrently(const std::string& key, const std::string& value,
+                                 uint64_t transaction_id) {
+  // 节点的第 0 层指针用作桶内链表, 新节点通过 CAS 插到链表头部
+  Node*               node = Node::create(*arena_, key, value, 1, transaction_id, true);
+  std::atomic<Node*>& head = bucket(key);
+  Node*               old  = head.load(std::memory_order_relaxed);
+  do {
+    node->no_barrier_set_next(0, old);
+  } while (!head.compare_exchange_weak(old, node, std::memory_order_release,
+                                       std::memory_order_relaxed));
+  size_bytes += key.size() + value.size();
+  view_.note_write();
+  return true;
+}
+
+Node* HashRep::Get(const std::string& key, uint64_t transaction_id) {
+  // 桶内按写入顺序从新到旧排列, 取可见的最大版本, 同一版本以后写入的为准
+  uint64_t visible = visible_id(transaction_id);
+  Node*    result  = nullptr;
+  for (Node* node = bucket(key).load(std::memory_order_acquire); node; node = node->next(0)) {
+    if (node->transaction_id <= visible && node->key_ == key &&
+        (result == nullptr || node->transaction_id > result->transaction_id)) {
+      result = node;
+    }
+  }
+  return result;
+}
+
+SkiplistIterator HashRep::get_iterator(const std::string& key, uint64_t transaction_id) {
+  // 节点的第 0 层指针是桶内链表, 不带头节点的游标不会沿着它移动
+  return SkiplistIterator(Get(key, transaction_id), arena_);
+}
+
+std::shared_ptr<Skiplist> HashRep::sorted_view() {
+  return view_.get([this] {
+    // 桶内链表从新到旧, 反转成写入顺序后再统一排序
+    std::vector<Node*> entries;
+    std::vector<Node*> chain;
+    for (std::size_t i = 0; i < bucket_count_; ++i) {
+      chain.clear();
+      for (Node* node = buckets_[i].load(std::memory_order_acquire); node;
+           node = node->next(0)) {
+        chain.push_back(node);
+      }
+      entries.insert(entries.end(), chain.rbegin(), chain.rend());
+    }
+    return entries;
+  });
+}
+
+std::size_t HashRep::get_size() {
+  return size_bytes;
+}
+
+std::size_t HashRep::memory_usage() const {
+  return arena_->memory_usage() + bucket_count_ * sizeof(std::atomic<Node*>);
+}
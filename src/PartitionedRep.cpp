@@ -0,0 +1,110 @@
+#include "../include/PartitionedRep.h"
+
+PartitionedRep::PartitionedRep(std::string_view common_prefix, int partitions)
+    : common_prefix_(common_prefix),
+      partition_count_(partitions),
+      partitions_(std::make_unique<Partition[]>(partitions)) {
+  for (int i = 0; i < partition_count_; ++i) {
+    partitions_[i].table = std::make_shared<Skiplist>(MAX_LEVEL, common_prefix_);
+  }
+}
+
+PartitionedRep::Partition& PartitionedRep::partition(std::string_view key) {
+  int range = partitions_[0].table->get_range_index(key);
+  return partitions_[range % partition_count_];
+}
+
+bool PartitionedRep::Insert(const std::string& key, const std::string& value,
+                            uint64_t transaction_id) {
+  Partition&                  part = partition(key);
+  std::lock_guard<std::mutex> lock(part.write_mutex);
+  return part.table->Insert(key, value, transaction_id);
+}
+
+bool PartitionedRep::InsertConcurrently(const std::string& key, const std::string& value,
+                                        uint64_t transaction_id) {
+  return Insert(key, value, transaction_id);
+}
+
+void PartitionedRep::InsertBatch(
+    const std::vector<const std::pair<std::string, std::string>*>& sorted,
+    uint64_t                                                        transaction_id) {
+  std::vector<const std::pair<std::string, std::string>*> run;
+  for (std::size_t i = 0; i < sorted.size();) {
+    Partition& part = partition(sorted[i]->first);
+    run.clear();
+    // key 有序, 同一范围的 key 是连续的一段
+    for (; i < sorted.size() && &partition(sorted[i]->first) == &part; ++i) {
+      run.push_back(sorted[i]);
+    }
+    std::lock_guard<std::mutex> lock(part.write_mutex);
+    part.table->InsertBatch(run, transaction_id);
+  }
+}
+
+Node* PartitionedRep::Get(const std::string& key, uint64_t transaction_id) {
+  return partition(key).table->Get(key, transaction_id);
+}
+
+SkiplistIterator PartitionedRep::get_iterator(const std::string& key, uint64_t transaction_id) {
+  return partition(key).table->get_iterator(key, transaction_id);
+}
+
+void PartitionedRep::GetBatch(const std::vector<const std::string*>& sorted,
+                              uint64_t transaction_id, std::vector<Node*>& nodes) {
+  nodes.clear();
+  nodes.reserve(sorted.size());
+  std::vector<const std::string*> run;
+  std::vector<Node*>              found;
+  for (std::size_t i = 0; i < sorted.size();) {
+    Partition& part = partition(*sorted[i]);
+    run.clear();
+    for (; i < sorted.size() && &partition(*sorted[i]) == &part; ++i) {
+      run.push_back(sorted[i]);
+    }
+    part.table->GetBatch(run, transaction_id, found);
+    nodes.insert(nodes.end(), found.begin(), found.end());
+  }
+}
+
+std::pair<SkiplistIterator, SkiplistIterator> PartitionedRep::prefix_range(
+    const std::string& key, uint64_t transaction_id) {
+  if (key.size() > common_prefix_.size() && key.starts_with(common_prefix_)) {
+    return partition(key).table->prefix_range(key, transaction_id);
+  }
+  return MemTableRep::prefix_range(key, transaction_id);
+}
+
+std::shared_ptr<Skiplist> PartitionedRep::sorted_view() {
+  auto               table = std::make_shared<Skiplist>(MAX_LEVEL, common_prefix_);
+  std::vector<Node*> nodes;
+  for (int range = 0; range < Skiplist::MAX_RANGES; ++range) {
+    const auto& part = partitions_[range % partition_count_].table;
+    auto        it   = part->begin();
+    if (range > 0) {
+      it.Seek(common_prefix_ + static_cast<char>(range));
+    }
+    // 迭代器已经跳过了同一版本被覆盖的旧值
+    for (; it.valid() && part->get_range_index(it.key()) == range; ++it) {
+      nodes.push_back(table->AllocateNode(it.key(), it.value(), it.getseq()));
+    }
+  }
+  table->AppendSorted(nodes);
+  return table;
+}
+
+std::size_t PartitionedRep::get_size() {
+  std::size_t size = 0;
+  for (int i = 0; i < partition_count_; ++i) {
+    size += partitions_[i].table->get_size();
+  }
+  return size;
+}
+
+std::size_t PartitionedRep::memory_usage() const {
+  std::size_t usage = 0;
+  for (int i = 0; i < partition_count_; ++i) {
+    usage += partitions_[i].table->memory_usage();
+  }
+  return usage;
+}
@@ -1,18 +1,29 @@
 #include "../include/Skiplist.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <optional>
 
 auto Node::operator<=>(const Node& other) const {
   return key_ <=> other.key_;
 }
 
-SkiplistIterator::SkiplistIterator(std::shared_ptr<Node> skiplist) {
-  current = skiplist;
-}
+SkiplistIterator::SkiplistIterator(Node* node, std::shared_ptr<Arena> arena, Node* head)
+    : current(node), head_(head), arena_(std::move(arena)) {}
 SkiplistIterator::SkiplistIterator() : current(nullptr) {}
 BaseIterator& SkiplistIterator::operator++() {
-  if (current) {
-    current = current->forward[0];
+  if (head_ == nullptr) {
+    current = nullptr;  // 单个条目的游标, 节点的第 0 层指针不一定是有序链表
+  } else if (current) {
+    // 同一版本被重复写入时, 新节点排在前面, 跳过被它遮蔽的旧节点;
+    // 同 key 的其他版本照常返回
+    Node* next = current->next(0);
+    while (next && next->transaction_id == current->transaction_id && next->key_ == current->key_) {
+      next = next->next(0);
+    }
+    current = next;
   }
   return *this;
 }
@@ -28,7 +39,7 @@ bool operator==(const SkiplistIterator& lhs, const SkiplistIterator& rhs) noexce
 }
 
 SkiplistIterator::valuetype SkiplistIterator::operator*() const {
-  return {current->key_, current->value_};
+  return {std::string(current->key_), std::string(current->value_)};
 }
 SkiplistIterator SkiplistIterator::operator+=(int offset) const {
   SkiplistIterator result = *this;
@@ -54,49 +65,264 @@ uint64_t SkiplistIterator::getseq() const {
 }
 std::pair<std::string, std::string> SkiplistIterator::getValue() const {
   if (current) {
-    return {current->key_, current->value_};
+    return {std::string(current->key_), std::string(current->value_)};
   }
   return {"", ""};
 }
 
-bool Skiplist::Insert(const std::string& key, const std::string& value, uint64_t transaction_id) {
-  auto result = Contain(key);
-  if (result.has_value() && result.value() == value) {
-    // 如果已经存在，则不插入
-    return false;
+Skiplist::SearchKey Skiplist::make_search_key(const Node* head, std::string_view key) {
+  std::string_view common = head->key_;
+  bool             prefixed = key.starts_with(common);
+  return {key, prefixed ? encode_prefix(key, common.size()) : 0, prefixed};
+}
+
+uint64_t Skiplist::encode_prefix(std::string_view key, std::size_t offset) {
+  std::size_t available = key.size() - offset;
+  uint64_t    result    = 0;
+  if (available >= sizeof(uint64_t)) {
+    std::memcpy(&result, key.data() + offset, sizeof(uint64_t));
+    if constexpr (std::endian::native == std::endian::little) {
+      result = std::byteswap(result);
+    }
+    return result;
+  }
+  for (std::size_t i = 0; i < available; ++i) {
+    result |= static_cast<uint64_t>(static_cast<unsigned char>(key[offset + i])) << (56 - 8 * i);
+  }
+  return result;
+}
+
+bool Skiplist::node_before(const Node* node, const SearchKey& key, uint64_t transaction_id) {
+  // 两边都带公共前缀且缓存的前缀不同, 一次整数比较就能决定顺序
+  if (node->prefixed && key.prefixed && node->key_prefix != key.prefix) {
+    return node->key_prefix < key.prefix;
+  }
+  int cmp = node->key_.compare(key.key);
+  return cmp < 0 || (cmp == 0 && node->transaction_id > transaction_id);
+}
+
+uint64_t Skiplist::visible_id(uint64_t transaction_id) {
+  return transaction_id == 0 ? UINT64_MAX : transaction_id;
+}
+std::string_view SkiplistIterator::key() const {
+  return current->key_;
+}
+std::string_view SkiplistIterator::value() const {
+  return current->value_;
+}
+
+// 头节点的塔高是跳表的最大层级, 高于当前层级的部分全为空, 可以直接从最高层开始查找
+void SkiplistIterator::Seek(std::string_view key, uint64_t transaction_id) {
+  if (head_ == nullptr) {
+    current = nullptr;
+    return;
+  }
+  current = Skiplist::find_greater_or_equal(head_, head_->height, key, transaction_id, nullptr);
+}
+void SkiplistIterator::SeekToFirst() {
+  current = head_ ? head_->next(0) : nullptr;
+}
+void SkiplistIterator::SeekToLast() {
+  if (head_ == nullptr) {
+    current = nullptr;
+    return;
+  }
+  settle(Skiplist::find_last(head_, head_->height));
+}
+void SkiplistIterator::SeekForPrev(std::string_view key) {
+  if (head_ == nullptr) {
+    current = nullptr;
+    return;
+  }
+  // 第一个 key 大于目标的节点是 >= (key + '\0', 最新版本) 的第一个节点, 取它之前的节点
+  std::string upper(key);
+  upper.push_back('\0');
+  settle(Skiplist::find_less_than(head_, head_->height, upper, UINT64_MAX));
+}
+void SkiplistIterator::Prev() {
+  if (current == nullptr || head_ == nullptr) {
+    current = nullptr;
+    return;
   }
-  std::vector<std::shared_ptr<Node>> update(MAX_LEVEL, nullptr);
-  auto                               current = head;
+  settle(Skiplist::find_less_than(head_, head_->height, current->key_, current->transaction_id));
+}
+void SkiplistIterator::settle(Node* node) {
+  if (node == head_) {
+    current = nullptr;
+    return;
+  }
+  // 同一版本被重复写入时, 反向查找落在这组节点的最后一个(被遮蔽的旧值)上,
+  // 再下降一次定位到正向迭代返回的第一个节点
+  current = Skiplist::find_greater_or_equal(head_, head_->height, node->key_,
+                                            node->transaction_id, nullptr);
+}
+
+Node* Skiplist::find_greater_or_equal(std::string_view key, uint64_t transaction_id,
+                                      Node** prev) const {
+  return find_greater_or_equal(head, get_max_height(), key, transaction_id, prev);
+}
 
-  // 查找插入位置
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
+Node* Skiplist::find_less_than(Node* head, int height, std::string_view key,
+                               uint64_t transaction_id) {
+  SearchKey search  = make_search_key(head, key);
+  Node*     current = head;
+  int   level   = height - 1;
+  while (true) {
+    Node* next = current->next(level);
+    if (next && node_before(next, search, transaction_id)) {
+      current = next;
+    } else if (level == 0) {
+      return current;
+    } else {
+      level--;
     }
-    if (current->forward[i] && current->forward[i]->key_ == key &&
-        current->forward[i]->transaction_id <= transaction_id) {
-      // 如果当前节点的key等于要插入的key，同时transation_id小于等于当前id,则更新
-      size_bytes += value.size() - current->forward[0]->value_.size();
-      // 更新节点的值
-      current->forward[0]->value_         = value;
-      current->forward[0]->transaction_id = transaction_id;
-      return true;
+  }
+}
+
+Node* Skiplist::find_last(Node* head, int height) {
+  Node* current = head;
+  int   level   = height - 1;
+  while (true) {
+    Node* next = current->next(level);
+    if (next) {
+      current = next;
+    } else if (level == 0) {
+      return current;
+    } else {
+      level--;
     }
-    update[i] = current;  // 记录需要更新的节点
   }
-  // 拿到新的节点的高度
+}
+
+Node* Skiplist::find_greater_or_equal(Node* head, int height, std::string_view key,
+                                      uint64_t transaction_id, Node** prev) {
+  SearchKey search  = make_search_key(head, key);
+  Node*     current = head;
+  int   level   = height - 1;
+  while (true) {
+    Node* next = current->next(level);
+    if (next && node_before(next, search, transaction_id)) {
+      current = next;  // 继续在当前层向右
+    } else {
+      if (prev != nullptr) {
+        prev[level] = current;
+      }
+      if (level == 0) {
+        return next;
+      }
+      level--;  // 下降一层
+    }
+  }
+}
+
+void Skiplist::find_splice_for_level(const SearchKey& key, uint64_t transaction_id, Node* before,
+                                     int level, Node** out_prev, Node** out_next) const {
+  while (true) {
+    Node* next = before->next(level);
+    if (next == nullptr || !node_before(next, key, transaction_id)) {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+    before = next;
+  }
+}
+
+bool Skiplist::splice_brackets(const Splice& splice, int level, const SearchKey& key,
+                               uint64_t transaction_id) const {
+  // prev < (key, id) <= next 且二者相邻
+  Node* prev = splice.prev[level];
+  Node* next = splice.next[level];
+  if (prev->next(level) != next) {
+    return false;  // 区间中间插入过其他节点
+  }
+  if (prev != head && !node_before(prev, key, transaction_id)) {
+    return false;  // key 在区间左侧
+  }
+  return next == nullptr || !node_before(next, key, transaction_id);  // 否则 key 在区间右侧
+}
+
+void Skiplist::recompute_splice(std::string_view key, uint64_t transaction_id, Splice& splice,
+                                int link_height) const {
+  SearchKey search = make_search_key(head, key);
+  int       height = get_max_height();
+  if (splice.height < height || splice.epoch != delete_epoch.load(std::memory_order_relaxed)) {
+    // 提示过期(跳表长高或删除过节点), 从头节点开始完整计算
+    splice.height = height;
+    splice.epoch  = delete_epoch.load(std::memory_order_relaxed);
+    Node* before  = head;
+    for (int i = height - 1; i >= 0; --i) {
+      find_splice_for_level(search, transaction_id, before, i, &splice.prev[i], &splice.next[i]);
+      before = splice.prev[i];
+    }
+    return;
+  }
+  // 自底向上找到第一层仍然夹住 key 的区间
+  int recompute = 0;
+  while (recompute < height && !splice_brackets(splice, recompute, search, transaction_id)) {
+    ++recompute;
+  }
+  // 更高的层不一定有效: InsertBatch 的局部提示、并发插入和追加都会在提示之外链接节点.
+  // 要链接新节点的层都必须夹住 key, 否则链接时会覆盖别人插入的节点;
+  // 有失效的层时从它上方第一个有效的层往下重新计算
+  int highest_invalid = -1;
+  for (int i = recompute + 1; i < std::min(link_height, height); ++i) {
+    if (!splice_brackets(splice, i, search, transaction_id)) {
+      highest_invalid = i;
+    }
+  }
+  if (highest_invalid >= 0) {
+    recompute = highest_invalid + 1;
+    while (recompute < height && !splice_brackets(splice, recompute, search, transaction_id)) {
+      ++recompute;
+    }
+  }
+  // 从仍然有效的那一层往下重新计算
+  for (int i = recompute - 1; i >= 0; --i) {
+    Node* before = (i + 1 < height) ? splice.prev[i + 1] : head;
+    find_splice_for_level(search, transaction_id, before, i, &splice.prev[i], &splice.next[i]);
+  }
+}
+
+bool Skiplist::Insert(const std::string& key, const std::string& value, uint64_t transaction_id) {
+  return InsertHint(key, value, transaction_id, insert_hint);
+}
+
+bool Skiplist::InsertHint(const std::string& key, const std::string& value,
+                          uint64_t transaction_id, Splice& splice) {
+  // 一次查找同时得到插入位置和已有的同版本节点. 新版本排在同 key 的旧版本之前;
+  // 同一版本重复写入时新节点排在旧节点之前, 读者总是先看到最后写入的值.
+  // 节点发布后不再修改, 读者无需加锁
+  // 先拿到新节点的高度, 提示中新节点要链接的每一层都需要校验
   int Newlevel = random_level();
+  recompute_splice(key, transaction_id, splice, Newlevel);
+  Node* existing = splice.next[0];
+  if (existing && existing->transaction_id == transaction_id && existing->key_ == key &&
+      existing->value_ == value) {
+    // 同一版本已经存在相同的值，则不插入
+    return false;
+  }
+
+  int height = get_max_height();
+  if (Newlevel > height) {
+    // 新层级的前驱是头节点
+    for (int i = height; i < Newlevel; i++) {
+      splice.prev[i] = head;
+      splice.next[i] = nullptr;
+    }
+    splice.height = Newlevel;
+    // 读者看到新高度时, 新层级上要么是 nullptr 要么是新节点, 两者都是合法状态
+    current_level.store(Newlevel, std::memory_order_relaxed);
+  }
   // 创建新节点
-  std::shared_ptr<Node> NewNode = std::make_shared<Node>(key, value, Newlevel, transaction_id);
-  // 插入新节点
+  Node* NewNode = new_node(key, value, Newlevel, transaction_id);
+  // 插入新节点: 先设置新节点的后继, 再通过 release 写把它发布给读者
   for (int i = 0; i < Newlevel; i++) {
-    if (update[i]) {  // 确保 update[i] 不为空
-      NewNode->forward[i]   = update[i]->forward[i];
-      update[i]->forward[i] = NewNode;
-    }
+    NewNode->no_barrier_set_next(i, splice.next[i]);
+    splice.prev[i]->set_next(i, NewNode);
+    // 下一个更大的 key 大概率落在 [NewNode, next) 之间
+    splice.prev[i] = NewNode;
   }
-  // 更新当前层级
-  current_level = std::max(current_level, Newlevel);
 
   // 更新内存占用
   size_bytes += key.size() + value.size();
@@ -104,82 +330,156 @@ bool Skiplist::Insert(const std::string& key, const std::string& value, uint64_t
   return true;
 }
 
-bool Skiplist::Delete(const std::string& key) {
-  auto result = Contain(key);
-  if (!result.has_value()) {
-    return false;  // 如果不存在，则不执行删除
+void Skiplist::InsertBatch(const std::vector<const std::pair<std::string, std::string>*>& sorted,
+                           uint64_t transaction_id) {
+  // 有序输入的每个 key 都落在上一个 key 的插入位置附近, 复用同一个 splice 从左到右归并
+  Splice splice;
+  for (const auto* pair : sorted) {
+    InsertHint(pair->first, pair->second, transaction_id, splice);
+  }
+}
+
+Node* Skiplist::AllocateNode(std::string_view key, std::string_view value,
+                             uint64_t transaction_id) {
+  return new_node(key, value, random_level(), transaction_id, true);
+}
+
+void Skiplist::AppendSorted(const std::vector<Node*>& nodes) {
+  // 每一层的尾节点: 从头节点出发在每一层走到末尾
+  Node* tails[MAX_LEVEL];
+  Node* tail = head;
+  for (int i = max_level - 1; i >= 0; --i) {
+    while (Node* next = tail->next(i)) {
+      tail = next;
+    }
+    tails[i] = tail;
+  }
+  int height = get_max_height();
+  for (Node* node : nodes) {
+    for (int i = 0; i < node->height; ++i) {
+      node->no_barrier_set_next(i, nullptr);
+      tails[i]->set_next(i, node);
+      tails[i] = node;
+    }
+    height = std::max(height, node->height);
+    size_bytes += node->key_.size() + node->value_.size();
   }
-  auto                               current = head;
-  std::vector<std::shared_ptr<Node>> update(MAX_LEVEL, nullptr);
+  current_level.store(height, std::memory_order_relaxed);
+  nodecount += static_cast<int>(nodes.size());
+}
 
-  // 查找删除位置
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
+bool Skiplist::InsertConcurrently(const std::string& key, const std::string& value,
+                                  uint64_t transaction_id) {
+  int Newlevel = random_level();
+  // 通过 CAS 抬高当前层级, 失败说明其他写者已经抬高了
+  int height = get_max_height();
+  while (Newlevel > height) {
+    if (current_level.compare_exchange_weak(height, Newlevel)) {
+      height = Newlevel;
+      break;
     }
-    update[i] = current;  // 记录需要更新的节点
   }
-  // 删除节点
-  auto target = current->forward[0];
-  if (target && target->key_ == key) {
-    for (int i = 0; i < current_level; ++i) {
-      if (update[i]->forward[i] != target) {
+
+  // 自顶向下计算每一层的插入位置(splice)
+  SearchKey search = make_search_key(head, key);
+  Node*     prev[MAX_LEVEL];
+  Node* next[MAX_LEVEL];
+  Node* before = head;
+  for (int i = height - 1; i >= 0; --i) {
+    find_splice_for_level(search, transaction_id, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  Node* NewNode = new_node(key, value, Newlevel, transaction_id, true);
+  // 自底向上逐层 CAS 链接, 底层链接成功后节点即对读者可见
+  for (int i = 0; i < Newlevel; ++i) {
+    while (true) {
+      NewNode->no_barrier_set_next(i, next[i]);
+      if (prev[i]->cas_next(i, next[i], NewNode)) {
         break;
       }
-      update[i]->forward[i] = target->forward[i];
+      // 有其他写者在 prev[i] 之后插入了节点, 从 prev[i] 开始重新计算这一层的位置
+      find_splice_for_level(search, transaction_id, prev[i], i, &prev[i], &next[i]);
+    }
+  }
+
+  size_bytes += key.size() + value.size();
+  nodecount++;
+  return true;
+}
+
+bool Skiplist::Delete(const std::string& key) {
+  Node* update[MAX_LEVEL] = {nullptr};
+  Node* target            = find_greater_or_equal(key, UINT64_MAX, update);
+  if (target == nullptr || target->key_ != key) {
+    return false;  // 如果不存在，则不执行删除
+  }
+  // 删除该 key 的所有版本, 节点内存留在 Arena 中直到跳表被释放
+  int height = get_max_height();
+  while (target && target->key_ == key) {
+    for (int i = 0; i < height; ++i) {
+      if (update[i]->next(i) != target) {
+        break;
+      }
+      update[i]->set_next(i, target->next(i));
     }
     // 更新内存占用
     size_bytes -= (target->key_.size() + target->value_.size());
     nodecount--;
+    target = update[0]->next(0);
   }
 
+  // 被摘除的节点可能还被插入位置提示引用, 让所有提示失效
+  delete_epoch.fetch_add(1, std::memory_order_relaxed);
+
   // 更新当前层级
   // 如果当前层级的节点为空，则需要更新当前层级
-  for (int i = current_level - 1; i >= 0; --i) {
-    if (head->forward[i] == nullptr) {
-      current_level--;
-    }
+  while (height > 1 && head->next(height - 1) == nullptr) {
+    height--;
   }
+  current_level.store(height, std::memory_order_relaxed);
   return true;
 }
 
 std::optional<std::string> Skiplist::Contain(const std::string& key, uint64_t transaction_id) {
-  auto current = head;
-  // 从最高层开始查找
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
-    }
-    if (current->forward[i] && current->forward[i]->key_ == key) {
-      return current->forward[i]->value_;
-    }
+  Node* node = Get(key, transaction_id);
+  if (node) {
+    return std::string(node->value_);
   }
   return std::nullopt;  // 如果没有找到，返回空值
 }
 
-std::shared_ptr<Node> Skiplist::Get(const std::string& key, uint64_t transaction_id) {
-  auto current = head;
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
-    }
-    if (current->forward[i] && current->forward[i]->key_ == key) {
-      if (transaction_id == 0) {
-        return current->forward[i];
-      } else if (current->forward[i]->transaction_id <= transaction_id) {
-        return current->forward[i];
-      }
-    }
+Node* Skiplist::Get(const std::string& key, uint64_t transaction_id) {
+  // 一次下降定位到第一个 >= (key, id) 的节点, 它就是该快照可见的最新版本
+  Node* node = find_greater_or_equal(key, visible_id(transaction_id), nullptr);
+  if (node && node->key_ == key) {
+    return node;
   }
   return nullptr;
 }
 
+void Skiplist::GetBatch(const std::vector<const std::string*>& sorted, uint64_t transaction_id,
+                        std::vector<Node*>& nodes) {
+  nodes.clear();
+  nodes.reserve(sorted.size());
+  // 查找只读取提示, 不修改跳表, 可以与写者和其他读者并发
+  Splice   splice;
+  uint64_t id = visible_id(transaction_id);
+  for (const auto* key : sorted) {
+    recompute_splice(*key, id, splice);
+    Node* node = splice.next[0];
+    nodes.push_back(node && node->key_ == *key ? node : nullptr);
+  }
+}
+
+std::shared_ptr<Skiplist> Skiplist::sorted_view() {
+  return shared_from_this();
+}
+
 std::vector<std::pair<std::string, std::string>> Skiplist::flush() {
   std::vector<std::pair<std::string, std::string>> result;
-  auto                                             current = head->forward[0];
-  while (current) {
-    result.emplace_back(current->key_, current->value_);
-    current = current->forward[0];
+  for (auto it = begin(); it.valid(); ++it) {
+    result.emplace_back(it.current->key_, it.current->value_);
   }
   return result;
 }
@@ -187,58 +487,72 @@ std::size_t Skiplist::get_size() {
   return size_bytes;
 }
 
+std::size_t Skiplist::memory_usage() const {
+  return arena_->memory_usage();
+}
+
 std::size_t Skiplist::getnodecount() {
   return nodecount;
 }
 
+std::size_t Skiplist::level_node_count(int level) const {
+  std::size_t count = 0;
+  for (Node* node = head->next(level); node != nullptr; node = node->next(level)) {
+    ++count;
+  }
+  return count;
+}
+
 auto Skiplist::seekToFirst() {
-  return head->forward[0];
+  return head->next(0);
 }  // 定位到第一个元素
 auto Skiplist::seekToLast() {
-  auto current = head;
-  current      = current->forward[0];
-  while (current->forward[0]) {
-    current = current->forward[0];
-  }
-  return current;
+  // 自顶向下在每一层走到末尾, 不需要遍历整个最底层
+  Node* last = find_last(head, get_max_height());
+  return last == head ? nullptr : last;
 }
 SkiplistIterator Skiplist::end() {
-  return SkiplistIterator(nullptr);
+  return SkiplistIterator(nullptr, arena_, head);
 }
 SkiplistIterator Skiplist::begin() {
-  return SkiplistIterator(head->forward[0]);
+  return SkiplistIterator(head->next(0), arena_, head);
+}
+SkiplistIterator Skiplist::get_iterator(const std::string& key, uint64_t transaction_id) {
+  return SkiplistIterator(Get(key, transaction_id), arena_, head);
 }
 
 SkiplistIterator Skiplist::prefix_serach_begin(const std::string& key, uint64_t transaction_id) {
-  auto current = head;
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
-    }
-  }
-  if (current->forward[0] && current->forward[0]->transaction_id <= transaction_id) {
-    return SkiplistIterator(current->forward[0]);
-  }
-  return SkiplistIterator(nullptr);
+  // 与前缀完全相同的 key 跳过对该快照不可见的新版本
+  Node* node = find_greater_or_equal(key, visible_id(transaction_id), nullptr);
+  return SkiplistIterator(node, arena_, head);
 }
 SkiplistIterator Skiplist::prefix_serach_end(const std::string& key, uint64_t transaction_id) {
-  auto Newkey = key + '\xff';
-  auto result = prefix_serach_begin(key);
-  if (result.current == nullptr) {
-    return SkiplistIterator(nullptr);
+  // 前缀的后继: 去掉末尾的 0xff 后把最后一个字节加一, 所有带该前缀的 key 都小于它
+  std::string upper = key;
+  while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xff) {
+    upper.pop_back();
   }
-  auto                     current = result.current;
-  std::vector<std::string> skipmap;
-  // 从最高层开始查找
-
-  while (current && current->key_ < Newkey) {
-    skipmap.push_back(current->key_);
-    current = current->forward[0];
+  if (upper.empty()) {
+    return SkiplistIterator(nullptr, arena_, head);
   }
-  if (current) {
-    skipmap.push_back(current->key_);
+  upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+  // 一次下降找到第一个不满足前缀的节点(包括它的所有版本)
+  Node* node = find_greater_or_equal(upper, UINT64_MAX, nullptr);
+  return SkiplistIterator(node, arena_, head);
+}
+std::pair<SkiplistIterator, SkiplistIterator> Skiplist::prefix_range(const std::string& key,
+                                                                    uint64_t transaction_id) {
+  return {prefix_serach_begin(key, transaction_id), prefix_serach_end(key, transaction_id)};
+}
+std::string Skiplist::key_common_prefix() {
+  Node* first = head->next(0);
+  Node* last  = find_last(head, get_max_height());
+  if (first == nullptr) {
+    return std::string(head->key_);
   }
-  return SkiplistIterator(Get(skipmap.back(), transaction_id));
+  auto mismatch = std::mismatch(first->key_.begin(), first->key_.end(), last->key_.begin(),
+                                last->key_.end());
+  return std::string(first->key_.begin(), mismatch.first);
 }
 void Skiplist::set_status(Global_::SkiplistStatus status) {
   cur_status = status;
@@ -248,12 +562,68 @@ Global_::SkiplistStatus Skiplist::get_status() const {
   return cur_status;
 }
 
+int Skiplist::get_range_index(std::string_view key) const {
+  std::string_view prefix = head->key_;
+  if (key.size() > prefix.size() && key.starts_with(prefix)) {
+    return static_cast<unsigned char>(key[prefix.size()]) * MAX_RANGES / 256;
+  }
+  // 小于等于公共前缀的 key 排在所有带前缀的 key 之前, 其余的排在之后
+  return key <= prefix ? 0 : MAX_RANGES - 1;
+}
+
+void Skiplist::build_key_filter() {
+  auto filter = std::make_unique<BlockedBloomFilter>(nodecount.load(),
+                                                     Global_::MEMTABLE_FILTER_BITS_PER_KEY);
+  // 同一个 key 的版本相邻, 只加入一次
+  std::string_view last;
+  for (Node* node = head->next(0); node != nullptr; node = node->next(0)) {
+    if (node == head->next(0) || node->key_ != last) {
+      filter->add(node->key_);
+      last = node->key_;
+    }
+  }
+  filter_ = std::move(filter);
+}
+
+bool Skiplist::may_contain(std::string_view key) const {
+  return filter_ == nullptr || filter_->possibly_contains(key);
+}
+
 thread_local std::mt19937 Skiplist::gen(std::random_device{}());
 
+Node* Node::create(Arena& arena, std::string_view key, std::string_view value, int level,
+                   uint64_t transaction_id, bool concurrent) {
+  // 布局: [Node][额外的 level-1 个前向指针][key][value]
+  std::size_t node_bytes = sizeof(Node) + sizeof(std::atomic<Node*>) * (level - 1);
+  std::size_t total      = node_bytes + key.size() + value.size();
+  char* mem = concurrent ? arena.allocate_aligned_concurrent(total) : arena.allocate_aligned(total);
+  char* key_ptr   = mem + node_bytes;
+  char* value_ptr = key_ptr + key.size();
+  std::memcpy(key_ptr, key.data(), key.size());
+  std::memcpy(value_ptr, value.data(), value.size());
+  return new (mem) Node(std::string_view(key_ptr, key.size()),
+                        std::string_view(value_ptr, value.size()), level, transaction_id);
+}
+
+Node* Skiplist::new_node(std::string_view key, std::string_view value, int level,
+                         uint64_t transaction_id, bool concurrent) {
+  Node* node = Node::create(*arena_, key, value, level, transaction_id, concurrent);
+  if (head != nullptr) {
+    SearchKey search = make_search_key(head, key);
+    node->key_prefix = search.prefix;
+    node->prefixed   = search.prefixed;
+  }
+  return node;
+}
+
+int Skiplist::get_max_height() const {
+  return current_level.load(std::memory_order_relaxed);
+}
+
 int Skiplist::random_level() {
-  static constexpr double P     = 0.25;  // 每一层的概率
-  int                     level = 1;
-  while (dis(gen) < P && level < max_level) {
+  // 每一层的概率为 1/4; 只使用线程局部的随机数引擎, 并发写者之间没有共享状态
+  int level = 1;
+  while ((gen() & 3) == 0 && level < max_level) {
     ++level;
   }
   return level;
@@ -1,5 +1,6 @@
 #include "../include/Sstable.h"
 #include "../include/SstableIterator.h"
+#include "../include/Compression.h"
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
@@ -9,6 +10,17 @@
 #include <vector>
 #include <print>
 
+namespace {
+// 文件尾部: meta_offset(uint32_t) + bloom_offset(uint32_t) + min_tranc_id(uint64_t)
+// + max_tranc_id(uint64_t) + checksum_type(uint8_t) + version(uint8_t) + magic(uint32_t).
+// 旧文件只有前四项, 元数据块用 std::hash 校验; 旧文件的最后 4 字节是 max_tranc_id 的高位,
+// 事务 id 达不到魔数的大小
+constexpr uint32_t kSstMagic         = 0x4c534d54;
+constexpr uint8_t  kSstFooterVersion = 1;
+constexpr size_t   kLegacyFooterSize = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2;
+constexpr size_t   kFooterSize = kLegacyFooterSize + sizeof(uint8_t) * 2 + sizeof(uint32_t);
+}  // namespace
+
 void Sstable::del_sst() {
   file_obj.del_file();
 }
@@ -20,31 +32,37 @@ std::shared_ptr<Sstable> Sstable::open(size_t sst_id, FileObj file_obj_,
   sst->block_cache = block_cache;
   size_t file_size = sst->file_obj.size();
   // 读取文件末尾的元数据块
-  if (file_size < sizeof(uint64_t) * 2 + sizeof(uint32_t) * 2) {
+  if (file_size < kLegacyFooterSize) {
     throw std::runtime_error("Invalid SST file: too small");
   }
 
-  // 0. 读取最大和最小的事务id
-  auto max_tranc_id = sst->file_obj.read_to_slice(file_size - sizeof(uint64_t), sizeof(uint64_t));
-  memcpy(&sst->max_tranc_id, max_tranc_id.data(), sizeof(uint64_t));
-
-  auto min_tranc_id =
-      sst->file_obj.read_to_slice(file_size - sizeof(uint64_t) * 2, sizeof(uint64_t));
-  memcpy(&sst->min_tranc_id, min_tranc_id.data(), sizeof(uint64_t));
-
-  // 1. 读取元数据块的偏移量, 最后8字节: 2个 uint32_t,
-  // 分别是 meta 和 bloom 的 offset
-
-  auto bloom_offset_bytes = sst->file_obj.read_to_slice(
-      file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t), sizeof(uint32_t));
-  memcpy(&sst->bloom_offset, bloom_offset_bytes.data(), sizeof(uint32_t));
+  // 0. 有魔数的是新文件, 读取校验和类型
+  size_t footer_size = kLegacyFooterSize;
+  sst->checksum_type = Global_::ChecksumType::kStdHash;
+  if (file_size >= kFooterSize) {
+    auto     tail = sst->file_obj.read_to_slice(file_size - sizeof(uint8_t) * 2 - sizeof(uint32_t),
+                                                sizeof(uint8_t) * 2 + sizeof(uint32_t));
+    uint32_t magic;
+    memcpy(&magic, tail.data() + sizeof(uint8_t) * 2, sizeof(uint32_t));
+    if (magic == kSstMagic) {
+      if (tail[1] != kSstFooterVersion) {
+        throw std::runtime_error("Unsupported SST footer version");
+      }
+      sst->checksum_type = static_cast<Global_::ChecksumType>(tail[0]);
+      footer_size        = kFooterSize;
+    }
+  }
 
-  auto meta_offset_bytes = sst->file_obj.read_to_slice(
-      file_size - sizeof(uint64_t) * 2 - sizeof(uint32_t) * 2, sizeof(uint32_t));
-  memcpy(&sst->meta_block_offset, meta_offset_bytes.data(), sizeof(uint32_t));
+  // 1. 读取元数据块和 bloom 的偏移量, 以及最大和最小的事务id
+  auto footer = sst->file_obj.read_to_slice(file_size - footer_size, kLegacyFooterSize);
+  memcpy(&sst->meta_block_offset, footer.data(), sizeof(uint32_t));
+  memcpy(&sst->bloom_offset, footer.data() + sizeof(uint32_t), sizeof(uint32_t));
+  memcpy(&sst->min_tranc_id, footer.data() + sizeof(uint32_t) * 2, sizeof(uint64_t));
+  memcpy(&sst->max_tranc_id, footer.data() + sizeof(uint32_t) * 2 + sizeof(uint64_t),
+         sizeof(uint64_t));
 
   // 2. 读取 bloom filter
-  uint32_t bloom_size = file_size - sizeof(uint64_t) * 2 - sst->bloom_offset - sizeof(uint32_t) * 2;
+  uint32_t bloom_size = file_size - footer_size - sst->bloom_offset;
   auto     bloom_bytes = sst->file_obj.read_to_slice(sst->bloom_offset, bloom_size);
 
   auto bloom        = BloomFilter::decode(bloom_bytes);
@@ -53,7 +71,7 @@ std::shared_ptr<Sstable> Sstable::open(size_t sst_id, FileObj file_obj_,
   // 3. 读取并解码元数据块
   uint32_t meta_size  = sst->bloom_offset - sst->meta_block_offset;
   auto     meta_bytes = sst->file_obj.read_to_slice(sst->meta_block_offset, meta_size);
-  sst->block_metas    = BlockMeta::decode_meta_from_slice(meta_bytes);
+  sst->block_metas    = BlockMeta::decode_meta_from_slice(meta_bytes, sst->checksum_type);
 
   // 4. 设置首尾key
   if (!sst->block_metas.empty()) {
@@ -102,14 +120,22 @@ std::shared_ptr<Block> Sstable::read_block(size_t block_idx) {
     block_size = block_metas[block_idx + 1].offset_ - meta.offset_;
   }
 
-  // 读取block数据
+  // 读取block数据, 解码出的 Block 直接接管读缓冲区
   auto block_data = file_obj.read_to_slice(meta.offset_, block_size);
-  auto block_res  = Block::decode(block_data, true);
+  auto block_res  = Block::decode(std::move(block_data), true, verify_checksums);
 
   block_cache->put(sst_id, block_idx, block_res);
   return block_res;
 }
 
+void Sstable::set_verify_checksums(bool verify) {
+  verify_checksums = verify;
+}
+
+Global_::ChecksumType Sstable::get_checksum_type() const {
+  return checksum_type;
+}
+
 std::optional<size_t> Sstable::find_block_idx(const std::string& key) {
   // 先在布隆过滤器判断key是否存在
   if (bloom_filter != nullptr && !bloom_filter->possibly_contains(key)) {
@@ -124,7 +150,7 @@ std::optional<size_t> Sstable::find_block_idx(const std::string& key) {
     size_t      mid  = left + (right - left) / 2;
     const auto& meta = block_metas[mid];
     if (key < meta.first_key_) {
-      right = mid - 1;
+      right = mid;
     } else if (key > meta.last_key_) {
       left = mid + 1;
     } else {
@@ -288,7 +314,10 @@ std::vector<std::pair<std::string, std::string>> Sstable::get_prefix_range(const
   }
   return res;
 }
-Sstbuild::Sstbuild(size_t block_size, bool has_bloom) : block_(block_size) {
+Sstbuild::Sstbuild(size_t block_size, bool has_bloom, size_t level, bool block_hash_index)
+    : block_(block_size),
+      compression(compression_for_level(level)),
+      block_hash_index(block_hash_index) {
   // 初始化第一个block
   if (has_bloom) {
     bloom_filter = std::make_shared<BloomFilter>(Global_::bloom_filter_expected_size_,
@@ -302,6 +331,9 @@ void Sstbuild::clean() {
   data.clear();
   first_key.clear();
   last_key.clear();
+  // 事务id范围随 add 收窄
+  min_tranc_id = UINT64_MAX;
+  max_tranc_id = 0;
 }
 void Sstbuild::add(const std::string& key, const std::string& value, uint64_t tranc_id) {
   // 记录第一个key
@@ -347,7 +379,7 @@ void Sstbuild::finish_block() {
 
   auto old_block     = std::move(block_);
   block_             = Block(Global_::Block_SIZE);  // 创建新 block
-  auto encoded_block = old_block.encode(true);
+  auto encoded_block = old_block.encode(true, compression, block_hash_index);
 
   if (encoded_block.empty()) {
     std::print("ERROR: encoded_block is empty!\n");
@@ -381,7 +413,8 @@ std::shared_ptr<Sstable> Sstbuild::build(std::shared_ptr<BlockCache> block_cache
   }
 
   // 编码元数据块
-  std::vector<uint8_t> meta_block = BlockMeta::encode_meta_to_slice(block_metas);
+  std::vector<uint8_t> meta_block =
+      BlockMeta::encode_meta_to_slice(block_metas, Global_::ChecksumType::kCrc32c);
 
   // 计算元数据块的偏移量
   uint32_t meta_offset = data.size();
@@ -401,23 +434,28 @@ std::shared_ptr<Sstable> Sstbuild::build(std::shared_ptr<BlockCache> block_cache
     file_content.insert(file_content.end(), bf_data.begin(), bf_data.end());
   }
 
-  auto extra_len = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2;
+  auto extra_len = kFooterSize;
   file_content.resize(file_content.size() + extra_len);
+  uint8_t* footer = file_content.data() + file_content.size() - extra_len;
   // sizeof(uint32_t) * 2  表示: 元数据块的偏移量, 布隆过滤器偏移量,
   // sizeof(uint64_t) * 2  表示: 最小事务id,, 最大事务id
+  // 最后是校验和类型, 尾部版本和魔数
 
   // 4. 添加元数据块偏移量
-  memcpy(file_content.data() + file_content.size() - extra_len, &meta_offset, sizeof(uint32_t));
+  memcpy(footer, &meta_offset, sizeof(uint32_t));
 
   // 5. 添加布隆过滤器偏移量
-  memcpy(file_content.data() + file_content.size() - extra_len + sizeof(uint32_t), &bloom_offset,
-         sizeof(uint32_t));
+  memcpy(footer + sizeof(uint32_t), &bloom_offset, sizeof(uint32_t));
 
   // 6. 添加最大和最小的事务id
-  memcpy(file_content.data() + file_content.size() - sizeof(uint64_t) * 2, &min_tranc_id,
-         sizeof(uint64_t));
-  memcpy(file_content.data() + file_content.size() - sizeof(uint64_t), &max_tranc_id,
-         sizeof(uint64_t));
+  memcpy(footer + sizeof(uint32_t) * 2, &min_tranc_id, sizeof(uint64_t));
+  memcpy(footer + sizeof(uint32_t) * 2 + sizeof(uint64_t), &max_tranc_id, sizeof(uint64_t));
+
+  // 7. 添加校验和类型, 尾部版本和魔数
+  footer += kLegacyFooterSize;
+  footer[0] = static_cast<uint8_t>(Global_::ChecksumType::kCrc32c);
+  footer[1] = kSstFooterVersion;
+  memcpy(footer + sizeof(uint8_t) * 2, &kSstMagic, sizeof(uint32_t));
 
   FileObj file = FileObj::create_and_write(path, file_content);
 
@@ -435,5 +473,6 @@ std::shared_ptr<Sstable> Sstbuild::build(std::shared_ptr<BlockCache> block_cache
   res->block_cache       = block_cache;
   res->min_tranc_id      = min_tranc_id;
   res->max_tranc_id      = max_tranc_id;
+  res->checksum_type     = Global_::ChecksumType::kCrc32c;
   return res;
 }
\ No newline at end of file
@@ -40,7 +40,8 @@ SstIterator::SstIterator(std::shared_ptr<Sstable> sst, uint64_t tranc_id)
   m_block_it  = std::make_shared<BlockIterator>(block, 0, tranc_id);
 }
 
-SstIterator::SstIterator(std::shared_ptr<Sstable> sst, const std::string& key, uint64_t tranc_id) {
+SstIterator::SstIterator(std::shared_ptr<Sstable> sst, const std::string& key, uint64_t tranc_id)
+    : m_sst(sst), m_block_idx(0), max_tranc_id_(tranc_id) {
   seek(key);
 }
 SstIterator::SstIterator(std::shared_ptr<Sstable> sst, size_t block_idx,
@@ -104,18 +105,18 @@ void SstIterator::seek(const std::string& key) {
     return;
   }
 }
-std::string SstIterator::key() {
+std::string_view SstIterator::key() const {
   if (!m_block_it) {
     throw std::runtime_error("Iterator is invalid");
   }
-  return (*m_block_it)->first;
+  return m_block_it->key();
 }
 
-std::string SstIterator::value() {
+std::string_view SstIterator::value() const {
   if (!m_block_it) {
     throw std::runtime_error("Iterator is invalid");
   }
-  return (*m_block_it)->second;
+  return m_block_it->value();
 }
 
 BaseIterator& SstIterator::operator++() {
@@ -177,6 +178,10 @@ SstIterator::valuetype SstIterator::operator*() const {
 }
 
 uint64_t SstIterator::getseq() const {
+  // 与跳表迭代器一致, 返回当前条目的 transaction_id
+  if (valid()) {
+    return m_block_it->tranc_id();
+  }
   return max_tranc_id_;
 }
 IteratorType SstIterator::type() const {
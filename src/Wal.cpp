@@ -0,0 +1,211 @@
+#include "../include/Wal.h"
+#include "../include/Crc32c.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+constexpr std::size_t kHeaderSize = sizeof(uint32_t) * 2;                     // crc + 长度
+constexpr std::size_t kFixedSize  = sizeof(uint64_t) + sizeof(uint32_t) * 2;  // tid + 两个长度
+
+template <typename T>
+void put_fixed(std::vector<uint8_t>& out, T value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T get_fixed(const uint8_t* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+}  // namespace
+
+Wal::Wal(const std::string& path, Global_::WalSyncMode sync_mode,
+         std::chrono::milliseconds sync_interval)
+    : path_(path), sync_mode_(sync_mode), sync_interval_(sync_interval) {
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Failed to open wal: " + path + ": " + std::strerror(errno));
+  }
+  if (sync_mode_ == Global_::WalSyncMode::kPeriodic) {
+    sync_thread_ = std::thread(&Wal::sync_loop, this);
+  }
+}
+
+Wal::~Wal() {
+  if (sync_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    sync_cv_.notify_one();
+    sync_thread_.join();
+  }
+  if (sync_mode_ != Global_::WalSyncMode::kNone) {
+    ::fdatasync(fd_);
+  }
+  ::close(fd_);
+}
+
+void Wal::encode_record(std::vector<uint8_t>& out, std::string_view key, std::string_view value,
+                        uint64_t transaction_id) {
+  std::size_t start = out.size();
+  put_fixed<uint32_t>(out, 0);  // crc 在记录编码完成后回填
+  put_fixed<uint32_t>(out, static_cast<uint32_t>(kFixedSize + key.size() + value.size()));
+  put_fixed<uint64_t>(out, transaction_id);
+  put_fixed<uint32_t>(out, static_cast<uint32_t>(key.size()));
+  put_fixed<uint32_t>(out, static_cast<uint32_t>(value.size()));
+  out.insert(out.end(), key.begin(), key.end());
+  out.insert(out.end(), value.begin(), value.end());
+  uint32_t crc =
+      crc32c(out.data() + start + sizeof(uint32_t), out.size() - start - sizeof(uint32_t));
+  std::memcpy(out.data() + start, &crc, sizeof(uint32_t));
+}
+
+void Wal::add(std::string_view key, std::string_view value, uint64_t transaction_id) {
+  Writer writer;
+  encode_record(writer.records, key, value, transaction_id);
+  commit(writer);
+}
+
+void Wal::add_batch(const std::vector<std::pair<std::string, std::string>>& key_value_pairs,
+                    uint64_t                                                transaction_id) {
+  Writer writer;
+  for (const auto& [key, value] : key_value_pairs) {
+    encode_record(writer.records, key, value, transaction_id);
+  }
+  commit(writer);
+}
+
+void Wal::commit(Writer& writer) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  writers_.push_back(&writer);
+  writer.cv.wait(lock, [&] { return writer.done || writers_.front() == &writer; });
+  if (writer.done) {
+    // 已经由其他 leader 一起提交
+    if (!writer.ok) {
+      throw std::runtime_error("Failed to write wal: " + path_);
+    }
+    return;
+  }
+
+  // 成为 leader: 把排在后面的写者合并进同一次写入, 直到达到组大小上限
+  std::vector<uint8_t> group = std::move(writer.records);
+  Writer*              last  = &writer;
+  for (auto it = writers_.begin() + 1; it != writers_.end(); ++it) {
+    if (group.size() + (*it)->records.size() > Global_::WAL_MAX_GROUP_BYTES) {
+      break;
+    }
+    group.insert(group.end(), (*it)->records.begin(), (*it)->records.end());
+    last = *it;
+  }
+
+  // 写文件期间释放锁, 新来的写者继续排队, 组成下一个提交组
+  lock.unlock();
+  bool ok = write_all(group);
+  if (ok && sync_mode_ == Global_::WalSyncMode::kPerBatch) {
+    ok = ::fdatasync(fd_) == 0;
+  }
+  lock.lock();
+
+  if (ok && sync_mode_ == Global_::WalSyncMode::kPeriodic) {
+    dirty_ = true;
+  }
+  while (true) {
+    Writer* done = writers_.front();
+    writers_.pop_front();
+    done->ok   = ok;
+    done->done = true;
+    if (done != &writer) {
+      done->cv.notify_one();
+    }
+    if (done == last) {
+      break;
+    }
+  }
+  // 唤醒下一组的 leader
+  if (!writers_.empty()) {
+    writers_.front()->cv.notify_one();
+  }
+  if (!ok) {
+    throw std::runtime_error("Failed to write wal: " + path_);
+  }
+}
+
+bool Wal::write_all(const std::vector<uint8_t>& buf) {
+  std::size_t written = 0;
+  while (written < buf.size()) {
+    ssize_t n = ::write(fd_, buf.data() + written, buf.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+void Wal::sync() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dirty_ = false;
+  }
+  if (::fdatasync(fd_) != 0) {
+    throw std::runtime_error("Failed to sync wal: " + path_);
+  }
+}
+
+void Wal::sync_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    sync_cv_.wait_for(lock, sync_interval_, [this] { return stop_; });
+    if (!stop_ && dirty_) {
+      dirty_ = false;
+      lock.unlock();
+      ::fdatasync(fd_);
+      lock.lock();
+    }
+  }
+}
+
+std::vector<Wal::Record> Wal::read(const std::string& path) {
+  std::vector<Record> records;
+  std::ifstream       file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return records;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+
+  std::size_t offset = 0;
+  while (offset + kHeaderSize + kFixedSize <= data.size()) {
+    const uint8_t* header = data.data() + offset;
+    uint32_t       crc    = get_fixed<uint32_t>(header);
+    uint32_t       length = get_fixed<uint32_t>(header + sizeof(uint32_t));
+    // 崩溃时最后一组可能只写了一部分, 截断或校验失败的记录及其之后的内容都丢弃
+    if (length < kFixedSize || offset + kHeaderSize + length > data.size() ||
+        crc32c(header + sizeof(uint32_t), sizeof(uint32_t) + length) != crc) {
+      break;
+    }
+    const uint8_t* body      = header + kHeaderSize;
+    uint64_t       tranc_id  = get_fixed<uint64_t>(body);
+    uint32_t       key_len   = get_fixed<uint32_t>(body + sizeof(uint64_t));
+    uint32_t       value_len = get_fixed<uint32_t>(body + sizeof(uint64_t) + sizeof(uint32_t));
+    if (kFixedSize + key_len + value_len != length) {
+      break;
+    }
+    const char* key = reinterpret_cast<const char*>(body + kFixedSize);
+    records.push_back(Record{std::string(key, key_len), std::string(key + key_len, value_len),
+                             tranc_id});
+    offset += kHeaderSize + length;
+  }
+  return records;
+}
@@ -1,13 +1,67 @@
 #include "../include/memtable.h"
+#include "../include/Checkpoint.h"
+#include "../include/SstableIterator.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <future>
+#include <iostream>
 #include <mutex>
+#include <numeric>
 #include <utility>
+
+namespace {
+// 前缀的后继: 去掉末尾的 0xff 后把最后一个字节加一; 前缀为空或全是 0xff 时没有上界, 返回空串
+std::string prefix_upper_bound(const std::string& prefix) {
+  std::string upper = prefix;
+  while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xff) {
+    upper.pop_back();
+  }
+  if (!upper.empty()) {
+    upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+  }
+  return upper;
+}
+
+// 把 tables(新表在前)归并写入 sstbuild: key 升序, 同一个 key 的版本从新到旧,
+// 同一个版本出现在多张表中时只写最新的表中的那条
+void write_merged(const std::vector<std::shared_ptr<Skiplist>>& tables, Sstbuild& sstbuild) {
+  std::vector<SkiplistIterator> cursors;
+  for (const auto& table : tables) {
+    cursors.push_back(table->begin());
+  }
+  while (true) {
+    int next = -1;
+    for (int i = 0; i < static_cast<int>(cursors.size()); ++i) {
+      if (!cursors[i].valid()) {
+        continue;
+      }
+      if (next < 0 || cursors[i].key() < cursors[next].key() ||
+          (cursors[i].key() == cursors[next].key() &&
+           cursors[i].getseq() > cursors[next].getseq())) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      return;
+    }
+    auto     entry = cursors[next].getValue();
+    uint64_t seq   = cursors[next].getseq();
+    sstbuild.add(entry.first, entry.second, seq);
+    for (auto& cursor : cursors) {
+      while (cursor.valid() && cursor.key() == entry.first && cursor.getseq() == seq) {
+        ++cursor;
+      }
+    }
+  }
+}
+}  // namespace
+
 bool operator==(const MemTableIterator& lhs, const MemTableIterator& rhs) noexcept {
-  if (lhs.queue_.empty() || rhs.queue_.empty()) {
-    return lhs.queue_.empty() && rhs.queue_.empty();
+  if (!lhs.valid() || !rhs.valid()) {
+    return !lhs.valid() && !rhs.valid();
   }
-  return lhs.queue_.top().key_ == rhs.queue_.top().key_ &&
-         lhs.queue_.top().value_ == rhs.queue_.top().value_ &&
-         lhs.queue_.top().transaction_id_ == rhs.queue_.top().transaction_id_;
+  return lhs.getValue() == rhs.getValue() && lhs.getseq() == rhs.getseq();
 }
 MemTableIterator::MemTableIterator(std::vector<SerachIterator> iter, uint64_t transaction_id)
     : max_transaction_id(0) {
@@ -25,10 +79,20 @@ MemTableIterator::MemTableIterator(std::vector<SerachIterator> iter, uint64_t tr
   }
 }
 MemTableIterator::MemTableIterator(const SkiplistIterator& iter, uint64_t transaction_id)
-    : max_transaction_id(transaction_id) {
-  list_iter_ = std::make_shared<SkiplistIterator>(iter);
+    : MemTableIterator(std::vector<SkiplistIterator>{iter}, transaction_id) {}
+MemTableIterator::MemTableIterator(std::vector<SkiplistIterator> tables, uint64_t transaction_id)
+    : tables_(std::move(tables)), max_transaction_id(transaction_id) {
+  find_next_user_entry();
+}
+MemTableIterator::MemTableIterator(std::vector<SkiplistIterator> tables, uint64_t transaction_id,
+                                   std::string prefix)
+    : tables_(std::move(tables)), prefix_(std::move(prefix)), max_transaction_id(transaction_id) {
+  find_next_user_entry();
+}
+MemTable::~MemTable() {
+  stop_checkpoint_thread();
+  stop_flush_thread();
 }
-MemTable::~MemTable() = default;
 
 auto MemTableIterator::operator<=>(const BaseIterator& other) const {
   if (other.type() != IteratorType::MemTableIterator) {
@@ -51,6 +115,13 @@ BaseIterator::pvaluetype MemTableIterator::operator->() const {
   return current_value_.get();
 }
 MemTableIterator& MemTableIterator::operator++() {
+  if (!tables_.empty()) {
+    if (current_table_ >= 0) {
+      skip_key(std::string(tables_[current_table_].key()));
+      find_next_user_entry();
+    }
+    return *this;
+  }
   if (queue_.empty()) {
     return *this;
   }
@@ -70,9 +141,12 @@ MemTableIterator& MemTableIterator::operator++() {
   return *this;
 }
 bool MemTableIterator::isEnd() {
-  return queue_.empty();
+  return !valid();
 }
 uint64_t MemTableIterator::getseq() const {
+  if (!tables_.empty()) {
+    return current_table_ >= 0 ? tables_[current_table_].getseq() : 0;
+  }
   if (queue_.empty()) {
     return 0;
   }
@@ -82,12 +156,34 @@ IteratorType MemTableIterator::type() const {
   return IteratorType::MemTableIterator;
 }
 MemTableIterator::valuetype MemTableIterator::getValue() const {
+  if (!tables_.empty()) {
+    if (current_table_ < 0) {
+      return std::make_pair("", "");
+    }
+    return tables_[current_table_].getValue();
+  }
   if (queue_.empty()) {
     return std::make_pair("", "");
   }
   return std::make_pair(queue_.top().key_, queue_.top().value_);
 }
+std::string_view MemTableIterator::key() const {
+  if (!tables_.empty()) {
+    return current_table_ >= 0 ? tables_[current_table_].key() : std::string_view();
+  }
+  return queue_.empty() ? std::string_view() : std::string_view(queue_.top().key_);
+}
+std::string_view MemTableIterator::value() const {
+  if (!tables_.empty()) {
+    return current_table_ >= 0 ? tables_[current_table_].value() : std::string_view();
+  }
+  return queue_.empty() ? std::string_view() : std::string_view(queue_.top().value_);
+}
 void MemTableIterator::pop_value() {
+  if (!tables_.empty()) {
+    ++(*this);
+    return;
+  }
   if (queue_.empty()) {
     return;
   }
@@ -106,8 +202,8 @@ void MemTableIterator::pop_value() {
   }
 }
 void MemTableIterator::update_current_key_value() const {
-  if (!queue_.empty()) {
-    current_value_ = std::make_shared<valuetype>(queue_.top().key_, queue_.top().value_);
+  if (valid()) {
+    current_value_ = std::make_shared<valuetype>(getValue());
   } else {
     current_value_.reset();
   }
@@ -134,87 +230,269 @@ bool MemTableIterator::top_value_legal() const {
   }
 }
 
-MemTable::MemTable() {
-  current_table = std::make_shared<Skiplist>(MAX_LEVEL);
-  fixed_bytes   = 0;
+MemTable::MemTable(Global_::MemTableRepType rep_type) : rep_type_(rep_type) {
+  current_table = make_memtable_rep(rep_type_);
   cur_status    = SkiplistStatus::kNormal;
+  version_.store(std::make_shared<const MemTableVersion>(MemTableVersion{current_table, {}, 0}));
+}
+
+std::shared_ptr<const MemTableVersion> MemTable::current_version() const {
+  return version_.load(std::memory_order_acquire);
 }
 
 bool MemTableIterator::valid() const {
+  if (!tables_.empty()) {
+    return current_table_ >= 0;
+  }
   return !queue_.empty();
 }
+
+void MemTableIterator::find_next_user_entry() {
+  current_table_ = -1;
+  while (true) {
+    // 按 (key 升序, 版本降序) 选出最小的条目, 相同时新表优先
+    int smallest = -1;
+    for (int i = 0; i < static_cast<int>(tables_.size()); ++i) {
+      const auto& table = tables_[i];
+      if (!in_range(table)) {
+        continue;
+      }
+      if (smallest < 0) {
+        smallest = i;
+        continue;
+      }
+      const auto& best = tables_[smallest];
+      int         cmp  = table.key().compare(best.key());
+      if (cmp < 0 || (cmp == 0 && table.getseq() > best.getseq())) {
+        smallest = i;
+      }
+    }
+    if (smallest < 0) {
+      return;
+    }
+    auto& table = tables_[smallest];
+    if (max_transaction_id != 0 && table.getseq() > max_transaction_id) {
+      ++table;  // 对快照不可见的新版本
+      continue;
+    }
+    if (table.value().empty()) {
+      skip_key(std::string(table.key()));  // 删除标记, 更旧的版本也不可见
+      continue;
+    }
+    current_table_ = smallest;
+    return;
+  }
+}
+void MemTableIterator::skip_key(const std::string& key) {
+  for (auto& table : tables_) {
+    while (table.valid() && table.key() == key) {
+      ++table;
+    }
+  }
+}
+void MemTableIterator::position_before(const std::string& key) {
+  for (auto& table : tables_) {
+    table.Seek(key);
+    if (table.valid()) {
+      table.Prev();
+    } else {
+      table.SeekToLast();
+    }
+  }
+}
+void MemTableIterator::find_prev_user_entry() {
+  while (true) {
+    std::string largest;
+    bool        found = false;
+    for (const auto& table : tables_) {
+      if (in_range(table) && (!found || table.key() > largest)) {
+        largest = table.key();
+        found   = true;
+      }
+    }
+    if (!found) {
+      current_table_ = -1;
+      return;
+    }
+    // 正向定位到该 key, 由正向逻辑挑出可见的最新版本
+    for (auto& table : tables_) {
+      table.Seek(largest);
+    }
+    find_next_user_entry();
+    if (current_table_ >= 0 && tables_[current_table_].key() == largest) {
+      return;
+    }
+    // 该 key 对快照不可见或已被删除, 继续向前
+    position_before(largest);
+  }
+}
+bool MemTableIterator::in_range(const SkiplistIterator& table) const {
+  return table.valid() && (!prefix_ || table.key().starts_with(*prefix_));
+}
+void MemTableIterator::SeekToFirst() {
+  if (prefix_) {
+    Seek(*prefix_);
+    return;
+  }
+  for (auto& table : tables_) {
+    table.SeekToFirst();
+  }
+  find_next_user_entry();
+}
+void MemTableIterator::SeekToLast() {
+  std::string upper = prefix_ ? prefix_upper_bound(*prefix_) : "";
+  if (!upper.empty()) {
+    position_before(upper);
+  } else {
+    for (auto& table : tables_) {
+      table.SeekToLast();
+    }
+  }
+  find_prev_user_entry();
+}
+void MemTableIterator::Seek(const std::string& key) {
+  // 前缀游标不会定位到前缀范围之前
+  const std::string& target = prefix_ && key < *prefix_ ? *prefix_ : key;
+  for (auto& table : tables_) {
+    table.Seek(target);
+  }
+  find_next_user_entry();
+}
+void MemTableIterator::SeekForPrev(const std::string& key) {
+  Seek(key);
+  if (current_table_ >= 0 && tables_[current_table_].key() == key) {
+    return;
+  }
+  std::string bound = key;
+  if (prefix_) {
+    std::string upper = prefix_upper_bound(*prefix_);
+    if (!upper.empty() && upper < bound) {
+      bound = upper;
+    }
+  }
+  position_before(bound);
+  find_prev_user_entry();
+}
+void MemTableIterator::Prev() {
+  if (current_table_ < 0) {
+    return;
+  }
+  position_before(std::string(tables_[current_table_].key()));
+  find_prev_user_entry();
+}
 void MemTable::put(const std::string& key, const std::string& value, uint64_t transaction_id) {
+  if (wal_) {
+    wal_->add(key, value, transaction_id);
+  }
   current_table->Insert(key, value, transaction_id);
 }
 
 void MemTable::put_mutex(const std::string& key, const std::string& value,
                          uint64_t transaction_id) {
+  bool full = false;
   {
-    std::unique_lock<std::shared_mutex> lock(cur_lock_);
-    current_table->Insert(key, value, transaction_id);
+    // 共享锁只防止 current_table 被冻结替换, 多个写者可以同时无锁插入跳表;
+    // 日志也在锁内写入, 保证记录和数据落在同一张表对应的日志段中
+    std::shared_lock<std::shared_mutex> lock(cur_lock_);
+    if (wal_) {
+      // 并发写者在日志中组成提交组, 一次 write/fdatasync 覆盖多次写入
+      wal_->add(key, value, transaction_id);
+    }
+    current_table->InsertConcurrently(key, value, transaction_id);
+    full = current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
   }
-  if (current_table->get_size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-    std::unique_lock<std::shared_mutex> lock(fix_lock_);
-    frozen_cur_table();
+  if (full) {
+    try_frozen_cur_table();
   }
 }
 void MemTable::put_batch(const std::vector<std::pair<std::string, std::string>>& key_value_pairs,
                          uint64_t                                                transaction_id) {
+  // 先按 key 排序, 之后每个 key 都落在上一个 key 的插入位置附近, 可以复用同一个 splice
+  // 从左到右归并进跳表; stable_sort 保证批内重复的 key 仍然是后写入的生效
+  std::vector<const std::pair<std::string, std::string>*> sorted;
+  sorted.reserve(key_value_pairs.size());
   for (const auto& pair : key_value_pairs) {
-    current_table->Insert(pair.first, pair.second, transaction_id);
+    sorted.push_back(&pair);
   }
-  if (current_table->get_size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-    std::unique_lock<std::shared_mutex> lock(fix_lock_);
-    frozen_cur_table();
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const auto* lhs, const auto* rhs) { return lhs->first < rhs->first; });
+
+  wait_for_flush_room();
+  // 整个批次只加一次独占锁, 期间当前表不会被其他写者修改或冻结
+  std::unique_lock<std::shared_mutex> lock(cur_lock_);
+  if (wal_) {
+    wal_->add_batch(key_value_pairs, transaction_id);
+  }
+  current_table->InsertBatch(sorted, transaction_id);
+  if (current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
+    frozen_cur_table_locked();
   }
 }
 std::optional<std::string> MemTable::get(const std::string& key) {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_);
-  auto                                result = current_table->Contain(key);
-  if (result.has_value()) {
-    // 检查是否为删除标记
-    if (result.value().empty()) {
-      return std::nullopt;  // 如果是空值，表示该key已被删除
-    }
-    return result;
-  }
-
-  lock.unlock();
-  std::shared_lock<std::shared_mutex> second_lock(fix_lock_);
-  for (const auto& fixed_table : fixed_tables) {
-    auto result = fixed_table->Contain(key);
-    if (result.has_value()) {
-      // 同样检查固定表中的删除标记
-      if (result.value().empty()) {
+  // 各层只在 Arena/Block 的数据上比较, 找到可见的值后才拷贝一次;
+  // 读者只加载一次版本, 不加锁, 冻结和刷盘替换版本时不会阻塞查找
+  auto version = current_version();
+  if (Node* node = version->active->Get(key)) {
+    // 空值表示该 key 已被删除
+    if (node->value_.empty()) {
+      return std::nullopt;
+    }
+    return std::string(node->value_);
+  }
+
+  for (const auto& fixed_table : version->immutables) {
+    if (!fixed_table->may_contain(key)) {
+      continue;
+    }
+    if (Node* node = fixed_table->Get(key)) {
+      if (node->value_.empty()) {
+        return std::nullopt;
+      }
+      return std::string(node->value_);
+    }
+  }
+  // 刷盘线程先发布 SST 再丢弃跳表, 所以数据总能在其中一处找到
+  std::shared_lock<std::shared_mutex> sst_lock(sst_lock_);
+  for (const auto& sst : flushed_ssts_) {
+    auto iter = sst->get_Iterator(key, UINT64_MAX);
+    if (iter.valid() && iter.key() == key) {
+      auto value = iter.value();
+      if (value.empty()) {
         return std::nullopt;
       }
-      return result;
+      return std::string(value);
     }
   }
   return std::nullopt;
 }
 
 SkiplistIterator MemTable::cur_get(const std::string& key, uint64_t transaction_id) {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_);
-  return SkiplistIterator(current_table->Get(key, transaction_id));
+  return current_version()->active->get_iterator(key, transaction_id);
 }
 SkiplistIterator MemTable::fix_get(const std::string& key, uint64_t transaction_id) {
-  std::shared_lock<std::shared_mutex> lock(fix_lock_);
-  for (const auto& result : fixed_tables) {
-    if (result->Contain(key, transaction_id).has_value()) {
-      return SkiplistIterator(result->Get(key, transaction_id));
+  auto version = current_version();
+  for (const auto& result : version->immutables) {
+    if (!result->may_contain(key)) {
+      continue;
+    }
+    // 一次查找, 不拷贝 value
+    auto iter = result->get_iterator(key, transaction_id);
+    if (iter.valid()) {
+      return iter;
     }
   }
   return SkiplistIterator();
 }
 SkiplistIterator MemTable::get_mutex(const std::string& key, std::vector<std::string>& values) {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_);
-  return SkiplistIterator(current_table->Get(key));
-  lock.unlock();
-  std::shared_lock<std::shared_mutex> second_lock(fix_lock_);
-  for (const auto& result : fixed_tables) {
-    if (result->Contain(key).has_value()) {
-      return SkiplistIterator(result->Get(key));
+  auto version = current_version();
+  return version->active->get_iterator(key);
+  for (const auto& result : version->immutables) {
+    if (!result->may_contain(key)) {
+      continue;
+    }
+    auto iter = result->get_iterator(key);
+    if (iter.valid()) {
+      return iter;
     }
   }
   return SkiplistIterator();
@@ -223,126 +501,596 @@ SkiplistIterator MemTable::get_mutex(const std::string& key, std::vector<std::st
 std::vector<std::tuple<std::string, std::optional<std::string>, std::optional<uint64_t>>>
 MemTable::get_batch(const std::vector<std::string>& key_pairs, uint64_t transaction_id) {
   std::vector<std::tuple<std::string, std::optional<std::string>, std::optional<uint64_t>>> result;
-  for (const auto& pair : key_pairs) {
-    auto value = get(pair);
-    if (value.has_value() && !value.value().empty()) {  // 添加空值检查
-      result.emplace_back(pair, value, transaction_id);
-    } else {
-      result.emplace_back(pair, std::nullopt, std::nullopt);
+  result.reserve(key_pairs.size());
+  for (const auto& key : key_pairs) {
+    result.emplace_back(key, std::nullopt, std::nullopt);
+  }
+  // 按 key 排序后逐表查找, 每张表上后一个 key 从前一个 key 的位置继续; 结果仍按调用方的顺序返回
+  std::vector<size_t> pending(key_pairs.size());
+  std::iota(pending.begin(), pending.end(), 0);
+  std::stable_sort(pending.begin(), pending.end(), [&key_pairs](size_t lhs, size_t rhs) {
+    return key_pairs[lhs] < key_pairs[rhs];
+  });
+
+  std::vector<const std::string*> sorted;
+  std::vector<size_t>             candidates;
+  std::vector<Node*>              nodes;
+  std::vector<bool>               resolved(key_pairs.size(), false);
+
+  // 在一张表上查找还没有结果的 key; 找到的(包括删除标记)不再往更旧的表查找.
+  // filter 非空时先用表的 key 过滤器排除一定不在表中的 key
+  auto lookup = [&](MemTableRep& table, const Skiplist* filter) {
+    sorted.clear();
+    candidates.clear();
+    for (size_t index : pending) {
+      if (filter == nullptr || filter->may_contain(key_pairs[index])) {
+        candidates.push_back(index);
+        sorted.push_back(&key_pairs[index]);
+      }
+    }
+    if (candidates.empty()) {
+      return;
+    }
+    table.GetBatch(sorted, transaction_id, nodes);
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (nodes[i] == nullptr) {
+        continue;
+      }
+      resolved[candidates[i]] = true;
+      if (!nodes[i]->value_.empty()) {
+        std::get<1>(result[candidates[i]]) = std::string(nodes[i]->value_);
+        std::get<2>(result[candidates[i]]) = nodes[i]->transaction_id;
+      }
+    }
+    std::erase_if(pending, [&resolved](size_t index) { return resolved[index]; });
+  };
+
+  auto version = current_version();
+  lookup(*version->active, nullptr);
+  for (const auto& fixed_table : version->immutables) {
+    if (pending.empty()) {
+      break;
+    }
+    lookup(*fixed_table, fixed_table.get());
+  }
+  if (!pending.empty()) {
+    std::shared_lock<std::shared_mutex> lock(sst_lock_);
+    uint64_t read_id = transaction_id == 0 ? UINT64_MAX : transaction_id;
+    for (size_t index : pending) {
+      const auto& key = key_pairs[index];
+      for (const auto& sst : flushed_ssts_) {
+        auto iter = sst->get_Iterator(key, read_id);
+        if (iter.valid() && iter.key() == key) {
+          if (!iter.value().empty()) {
+            std::get<1>(result[index]) = std::string(iter.value());
+            std::get<2>(result[index]) = iter.getseq();
+          }
+          break;
+        }
+      }
     }
   }
   return result;
 }
 std::size_t MemTable::get_fixed_size() {
-  std::shared_lock<std::shared_mutex> lock(fix_lock_);
-  return fixed_bytes;
+  return current_version()->immutable_bytes;
 }
 std::size_t MemTable::get_cur_size() {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_);
-  return current_table->get_size();
+  return current_version()->active->get_size();
 }
 std::size_t MemTable::get_total_size() {
   return get_cur_size() + get_fixed_size();
 }
 
 void MemTable::remove(const std::string& key, uint64_t transaction_id) {
+  if (wal_) {
+    wal_->add(key, "", transaction_id);
+  }
   current_table->Insert(key, "", transaction_id);
-  if (current_table->get_size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
+  if (current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
     frozen_cur_table();
   }
 }
 void MemTable::remove_mutex(const std::string& key, uint64_t transaction_id) {
+  bool full = false;
   {
-    std::unique_lock<std::shared_mutex> lock(cur_lock_);
-    current_table->Insert(key, "", transaction_id);
+    std::shared_lock<std::shared_mutex> lock(cur_lock_);
+    if (wal_) {
+      wal_->add(key, "", transaction_id);
+    }
+    current_table->InsertConcurrently(key, "", transaction_id);
+    full = current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
   }
-  if (fixed_tables.size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-    std::unique_lock<std::shared_mutex> lock(fix_lock_);
-    frozen_cur_table();
+  if (full) {
+    try_frozen_cur_table();
   }
 }
 // 批量删除
 void MemTable::remove_batch(const std::vector<std::string>& key_pairs, uint64_t transaction_id) {
-  std::unique_lock<std::shared_mutex> lock(cur_lock_);
-  for (const auto& pair : key_pairs) {
-    current_table->Insert(pair, "", transaction_id);
+  {
+    std::unique_lock<std::shared_mutex> lock(cur_lock_);
+    if (wal_) {
+      std::vector<std::pair<std::string, std::string>> tombstones;
+      tombstones.reserve(key_pairs.size());
+      for (const auto& key : key_pairs) {
+        tombstones.emplace_back(key, "");
+      }
+      wal_->add_batch(tombstones, transaction_id);
+    }
+    for (const auto& pair : key_pairs) {
+      current_table->Insert(pair, "", transaction_id);
+    }
   }
-  if (current_table->get_size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-    std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  if (current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
     frozen_cur_table();
   }
 }
 bool MemTable::IsFull() {
-  return current_table->get_size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
+  return current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
 }
 
 // This function is used to flush the current memtable to disk,刷新到磁盘
 void MemTable::flush(Sstbuild& sstbuild) {
+  reject_if_flush_thread_running();
   std::unique_lock<std::shared_mutex> lock(cur_lock_);
-  auto                                new_table = std::make_shared<Skiplist>(MAX_LEVEL);
-  fixed_tables.push_back(std::move(current_table));
-  current_table = std::move(new_table);
-  fixed_bytes += current_table->get_size();
-  if (fixed_tables.size() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-    auto frozen_memtable = fixed_tables.front();
+  frozen_cur_table_locked();
+  // 不可变表的总量超过阈值时, 把最旧的一张写入 sstbuild
+  std::shared_ptr<Skiplist> frozen_memtable;
+  {
+    std::lock_guard<std::mutex> version_lock(version_mutex_);
+    auto next = std::make_shared<MemTableVersion>(*current_version());
+    if (next->immutable_bytes <= Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
+      return;
+    }
+    frozen_memtable = next->immutables.back();
     for (auto it = frozen_memtable->begin(); it != frozen_memtable->end(); ++it) {
       sstbuild.add(it.getValue().first, it.getValue().second, it.getseq());
     }
-    fixed_tables.pop_front();
+    next->immutable_bytes -= frozen_memtable->get_size();
+    next->immutables.pop_back();
+    version_.store(std::move(next), std::memory_order_release);
   }
+  // 数据还在 sstbuild 中, 日志段等调用方建好 SST 后再删除
+  defer_wal_segments({frozen_memtable});
 }
 void MemTable::flushsync(Sstbuild& sstbuild) {
+  reject_if_flush_thread_running();
   std::unique_lock<std::shared_mutex> lock(cur_lock_);
-  auto                                new_table = std::make_shared<Skiplist>(MAX_LEVEL);
-  fixed_tables.push_back(std::move(current_table));
-  current_table = std::move(new_table);
-  fixed_bytes += current_table->get_size();
-  auto& it = fixed_tables.front();
-  for (auto res = it->begin(); res != it->end(); ++res) {
-    sstbuild.add(res.getValue().first, res.getValue().second, res.getseq());
+  auto frozen   = current_table->sorted_view();
+  current_table = make_memtable_rep(rep_type_, frozen->key_common_prefix());
+  // 活跃表和所有不可变表一起写入 sstbuild 后丢弃, 新表在前
+  std::vector<std::shared_ptr<Skiplist>> tables{frozen};
+  {
+    std::lock_guard<std::mutex> version_lock(version_mutex_);
+    auto                        version = current_version();
+    tables.insert(tables.end(), version->immutables.begin(), version->immutables.end());
+    write_merged(tables, sstbuild);
+    version_.store(
+        std::make_shared<const MemTableVersion>(MemTableVersion{current_table, {}, 0}),
+        std::memory_order_release);
   }
-  fixed_tables.clear();
+  // 数据还在 sstbuild 中, 日志段等调用方建好 SST 后再删除
+  roll_wal_locked(frozen);
+  defer_wal_segments(tables);
+}
+void MemTable::reject_if_flush_thread_running() {
+  // 刷盘线程运行时由它负责删除不可变表, 同步刷盘会与它删除同一张表
+  std::lock_guard<std::mutex> lock(flush_mutex_);
+  if (flush_running_) {
+    throw std::logic_error("Cannot flush synchronously while the flush thread is running");
+  }
+}
+void MemTable::try_frozen_cur_table() {
+  wait_for_flush_room();
+  std::unique_lock<std::shared_mutex> lock(cur_lock_);
+  // 并发写者可能同时发现表满, 拿到锁后再检查一次, 只有第一个写者执行冻结
+  if (current_table->memory_usage() <= Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
+    return;
+  }
+  frozen_cur_table_locked();
 }
 void MemTable::frozen_cur_table() {
+  wait_for_flush_room();
+  std::unique_lock<std::shared_mutex> lock(cur_lock_);
+  frozen_cur_table_locked();
+}
+void MemTable::frozen_cur_table_locked() {
+  // 不可变表总是有序跳表: 跳表直接冻结, 其他表示在这里排序一次
+  auto frozen    = current_table->sorted_view();
+  auto temp_size = current_table->get_size();
+  // 新表沿用旧表 key 的公共前缀, 节点缓存的前缀从公共前缀之后开始取
+  auto new_table = make_memtable_rep(rep_type_, frozen->key_common_prefix());
+  // 表已不再写入, 在发布之前建立过滤器, 读者不会看到建到一半的过滤器
+  frozen->build_key_filter();
+  {
+    // 发布新版本之前读者继续在旧版本的活跃表上查找, 之后在不可变表中找到同样的数据
+    std::lock_guard<std::mutex> version_lock(version_mutex_);
+    auto next    = std::make_shared<MemTableVersion>(*current_version());
+    next->active = new_table;
+    next->immutables.insert(next->immutables.begin(), frozen);
+    next->immutable_bytes += temp_size;
+    version_.store(std::move(next), std::memory_order_release);
+  }
+  current_table = std::move(new_table);
+  // 活跃表的日志段交给冻结的表, 之后的写入落到新的段
+  roll_wal_locked(frozen);
+  std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+  flush_cv_.notify_one();
+}
+
+void MemTable::checkpoint(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+  checkpoint_locked(dir);
+}
+
+void MemTable::checkpoint_locked(const std::string& dir) {
+  auto path_of = [&dir](size_t id) { return dir + "/" + std::to_string(id) + ".ckpt"; };
+
+  // 编号按写入顺序递增, 加载时编号大的表更新; 不可变表从旧到新写, 活跃表最后写
+  // 活跃表和不可变表取自同一个版本
+  auto                                   version = current_version();
+  std::vector<std::shared_ptr<Skiplist>> immutables(version->immutables.rbegin(),
+                                                    version->immutables.rend());
+  auto                                   active = version->active->sorted_view();
+  for (const auto& table : immutables) {
+    bool written = std::any_of(checkpoints_.begin(), checkpoints_.end(),
+                               [&table](const auto& entry) { return entry.second.lock() == table; });
+    if (!written) {
+      size_t id = next_checkpoint_id_++;
+      Checkpoint::write(path_of(id), *table);
+      checkpoints_.emplace(id, table);
+    }
+  }
+  // 不可变表已经写入检查点, 重启时从检查点加载, 不再需要它们的日志段
+  retire_wal_segments(immutables);
+  // 活跃表还会继续写入, 每次写一份新的快照并删除上一份
+  std::optional<size_t> active_id;
+  if (active->begin().valid()) {
+    active_id = next_checkpoint_id_++;
+    Checkpoint::write(path_of(*active_id), *active);
+  }
+  if (active_checkpoint_) {
+    std::filesystem::remove(path_of(*active_checkpoint_));
+  }
+  active_checkpoint_ = active_id;
+  // 已经刷盘并被丢弃的表不再需要检查点
+  for (auto it = checkpoints_.begin(); it != checkpoints_.end();) {
+    if (it->second.expired()) {
+      std::filesystem::remove(path_of(it->first));
+      it = checkpoints_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MemTable::start_checkpoint_thread(const std::string& dir, std::chrono::milliseconds interval) {
+  std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+  if (checkpoint_thread_.joinable()) {
+    return;
+  }
+  checkpoint_stop_   = false;
+  checkpoint_thread_ = std::thread([this, dir, interval] {
+    std::unique_lock<std::mutex> lock(checkpoint_mutex_);
+    while (!checkpoint_cv_.wait_for(lock, interval, [this] { return checkpoint_stop_; })) {
+      try {
+        checkpoint_locked(dir);
+      } catch (const std::exception& e) {
+        // 写检查点失败不影响正常读写, 下一轮重试
+        std::cerr << "Failed to write checkpoint: " << e.what() << std::endl;
+      }
+    }
+  });
+}
+
+void MemTable::stop_checkpoint_thread() {
+  {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    if (!checkpoint_thread_.joinable()) {
+      return;
+    }
+    checkpoint_stop_ = true;
+  }
+  checkpoint_cv_.notify_one();
+  checkpoint_thread_.join();
+}
+
+void MemTable::load_checkpoints(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+  std::vector<std::pair<size_t, std::string>> files;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    const auto& path = entry.path();
+    if (path.extension() == ".tmp") {
+      std::filesystem::remove(path);  // 写到一半的检查点
+    } else if (path.extension() == ".ckpt") {
+      files.emplace_back(std::stoull(path.stem().string()), path.string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+
+  // 每个文件由一个线程加载, 文件内部再按块并行校验
+  std::vector<std::future<std::shared_ptr<Skiplist>>> loading;
+  for (const auto& file : files) {
+    loading.push_back(std::async(std::launch::async, [path = file.second] {
+      auto table = Checkpoint::load(path);
+      table->build_key_filter();
+      return table;
+    }));
+  }
+  std::vector<std::shared_ptr<Skiplist>> tables;
+  for (auto& future : loading) {
+    tables.push_back(future.get());
+  }
+
+  std::lock_guard<std::mutex> version_lock(version_mutex_);
+  auto                        next = std::make_shared<MemTableVersion>(*current_version());
+  for (size_t i = 0; i < tables.size(); ++i) {
+    next->immutable_bytes += tables[i]->get_size();
+    checkpoints_.emplace(files[i].first, tables[i]);
+    next_checkpoint_id_ = std::max(next_checkpoint_id_, files[i].first + 1);
+  }
+  // 编号大的表更新, 放在前面
+  next->immutables.insert(next->immutables.begin(), std::make_move_iterator(tables.rbegin()),
+                          std::make_move_iterator(tables.rend()));
+  version_.store(std::move(next), std::memory_order_release);
+  // 上次活跃表的快照已经作为不可变表加载
+  active_checkpoint_.reset();
+  // 刷盘线程运行时唤醒它刷盘加载的表
+  std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+  flush_cv_.notify_one();
+}
+
+std::string MemTable::wal_segment_path(uint64_t seq) const {
+  return wal_path_ + "." + std::to_string(seq);
+}
+
+void MemTable::open_wal(const std::string& path, Global_::WalSyncMode sync_mode) {
   std::unique_lock<std::shared_mutex> lock(cur_lock_);
-  auto                                new_table = std::make_shared<Skiplist>(MAX_LEVEL);
-  auto                                temp_size = current_table->get_size();
-  std::unique_lock<std::shared_mutex> lock2(fix_lock_);
-  fixed_tables.push_front(current_table);
-  current_table = new_table;
-  fixed_bytes += temp_size;
+  wal_path_      = path;
+  wal_sync_mode_ = sync_mode;
+
+  // 找出上次留下的日志段 <path>.<编号>
+  std::filesystem::path base(path);
+  std::filesystem::path dir    = base.has_parent_path() ? base.parent_path() : ".";
+  std::string           prefix = base.filename().string() + ".";
+  std::vector<uint64_t> segments;
+  if (std::filesystem::is_directory(dir)) {
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+      std::string name = entry.path().filename().string();
+      std::string seq  = name.substr(std::min(prefix.size(), name.size()));
+      if (name.starts_with(prefix) && !seq.empty() &&
+          std::all_of(seq.begin(), seq.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        segments.push_back(std::stoull(seq));
+      }
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+  // 旧版本只写一个不分段的日志文件, 当作最旧的段
+  if (std::filesystem::is_regular_file(path) &&
+      (segments.empty() || segments.front() > 0)) {
+    std::filesystem::rename(path, wal_segment_path(0));
+    segments.insert(segments.begin(), 0);
+  }
+
+  // 按编号从旧到新重放, 表满时冻结; 一个段的记录可能分布在相邻的两张表中,
+  // 段归属于包含它最后一条记录的表, 那张表刷盘时更早的表也已经刷盘
+  for (uint64_t seq : segments) {
+    auto records = Wal::read(wal_segment_path(seq));
+    if (records.empty()) {
+      std::filesystem::remove(wal_segment_path(seq));
+      continue;
+    }
+    active_wal_segments_.push_back(seq);
+    for (const auto& record : records) {
+      current_table->Insert(record.key, record.value, record.transaction_id);
+      if (current_table->memory_usage() > Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
+        frozen_cur_table_locked();
+        active_wal_segments_.push_back(seq);
+      }
+    }
+    next_wal_seq_ = std::max(next_wal_seq_, seq + 1);
+  }
+  // 之后的写入追加到新的段
+  std::lock_guard<std::mutex> wal_lock(wal_mutex_);
+  uint64_t                    seq = next_wal_seq_++;
+  wal_ = std::make_unique<Wal>(wal_segment_path(seq), wal_sync_mode_);
+  active_wal_segments_.push_back(seq);
+}
+
+void MemTable::roll_wal_locked(const std::shared_ptr<Skiplist>& frozen) {
+  std::lock_guard<std::mutex> lock(wal_mutex_);
+  for (uint64_t seq : active_wal_segments_) {
+    wal_segments_[seq] = frozen;
+  }
+  active_wal_segments_.clear();
+  if (wal_) {
+    // 每张活跃表写自己的日志段, 表刷盘后整段删除
+    uint64_t seq = next_wal_seq_++;
+    wal_         = std::make_unique<Wal>(wal_segment_path(seq), wal_sync_mode_);
+    active_wal_segments_.push_back(seq);
+  }
+}
+
+std::vector<uint64_t> MemTable::take_wal_segments_locked(
+    const std::vector<std::shared_ptr<Skiplist>>& tables) {
+  std::vector<uint64_t> taken;
+  for (auto it = wal_segments_.begin(); it != wal_segments_.end();) {
+    auto table = it->second.lock();
+    if (table && std::find(tables.begin(), tables.end(), table) != tables.end()) {
+      taken.push_back(it->first);
+      it = wal_segments_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return taken;
+}
+
+void MemTable::retire_wal_segments(const std::vector<std::shared_ptr<Skiplist>>& durable) {
+  std::lock_guard<std::mutex> lock(wal_mutex_);
+  for (uint64_t seq : take_wal_segments_locked(durable)) {
+    std::filesystem::remove(wal_segment_path(seq));
+  }
+}
+
+void MemTable::defer_wal_segments(const std::vector<std::shared_ptr<Skiplist>>& written) {
+  std::lock_guard<std::mutex> lock(wal_mutex_);
+  auto taken = take_wal_segments_locked(written);
+  pending_wal_segments_.insert(pending_wal_segments_.end(), taken.begin(), taken.end());
+}
+
+void MemTable::release_flushed_wal() {
+  std::lock_guard<std::mutex> lock(wal_mutex_);
+  for (uint64_t seq : pending_wal_segments_) {
+    std::filesystem::remove(wal_segment_path(seq));
+  }
+  pending_wal_segments_.clear();
+}
+
+void MemTable::start_flush_thread(std::shared_ptr<BlockCache> block_cache,
+                                  const std::string& sst_dir, size_t first_sst_id) {
+  std::lock_guard<std::mutex> lock(flush_mutex_);
+  if (flush_running_) {
+    return;
+  }
+  block_cache_   = std::move(block_cache);
+  sst_dir_       = sst_dir;
+  next_sst_id_   = first_sst_id;
+  flush_stop_    = false;
+  flush_error_   = nullptr;
+  flush_running_ = true;
+  flush_thread_  = std::thread(&MemTable::flush_loop, this);
+}
+
+void MemTable::stop_flush_thread() {
+  {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (!flush_running_) {
+      return;
+    }
+    flush_stop_ = true;
+  }
+  flush_cv_.notify_one();
+  flush_thread_.join();
+  std::lock_guard<std::mutex> lock(flush_mutex_);
+  flush_running_ = false;
+}
+
+void MemTable::wait_for_flush() {
+  std::unique_lock<std::mutex> lock(flush_mutex_);
+  room_cv_.wait(lock, [this] {
+    return !flush_running_ || flush_error_ || current_version()->immutables.empty();
+  });
+  rethrow_flush_error();
+}
+
+std::vector<std::shared_ptr<Sstable>> MemTable::get_flushed_ssts() {
+  std::shared_lock<std::shared_mutex> lock(sst_lock_);
+  return {flushed_ssts_.begin(), flushed_ssts_.end()};
 }
 
-MemTableIterator MemTable::begin() {
-  return MemTableIterator(fixed_tables.begin()->get()->begin(), 0);
+void MemTable::wait_for_flush_room() {
+  std::unique_lock<std::mutex> lock(flush_mutex_);
+  room_cv_.wait(lock, [this] {
+    return !flush_running_ || flush_error_ ||
+           current_version()->immutables.size() <
+               static_cast<size_t>(Global_::MAX_IMMUTABLE_MEMTABLES);
+  });
+  rethrow_flush_error();
+}
+
+void MemTable::rethrow_flush_error() {
+  // 调用方持有 flush_mutex_
+  if (flush_error_) {
+    std::rethrow_exception(flush_error_);
+  }
+}
+
+void MemTable::flush_loop() {
+  while (true) {
+    std::shared_ptr<Skiplist> table;
+    {
+      std::unique_lock<std::mutex> lock(flush_mutex_);
+      flush_cv_.wait(
+          lock, [this] { return flush_stop_ || !current_version()->immutables.empty(); });
+      // 最旧的一张在队尾
+      auto version = current_version();
+      if (version->immutables.empty()) {
+        return;  // 收到退出请求且队列已清空
+      }
+      table = version->immutables.back();
+    }
+    try {
+      auto sst = build_sst(*table);
+      if (sst) {
+        std::unique_lock<std::shared_mutex> lock(sst_lock_);
+        flushed_ssts_.push_front(std::move(sst));
+      }
+    } catch (...) {
+      // 刷盘失败时保留不可变表, 等待中的写者收到异常
+      std::lock_guard<std::mutex> lock(flush_mutex_);
+      flush_error_ = std::current_exception();
+      room_cv_.notify_all();
+      return;
+    }
+    {
+      // SST 已经发布, 之后加载新版本的读者在 SST 中找到这张表的数据
+      // 按身份删除刷盘的那张表, 刷盘期间可能有新的不可变表或检查点加载的表发布
+      std::lock_guard<std::mutex> version_lock(version_mutex_);
+      auto next = std::make_shared<MemTableVersion>(*current_version());
+      auto it   = std::find(next->immutables.begin(), next->immutables.end(), table);
+      if (it != next->immutables.end()) {
+        next->immutable_bytes -= table->get_size();
+        next->immutables.erase(it);
+        version_.store(std::move(next), std::memory_order_release);
+      }
+    }
+    // SST 已经发布, 这张表的日志段不再需要
+    retire_wal_segments({table});
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    room_cv_.notify_all();
+  }
+}
+
+std::shared_ptr<Sstable> MemTable::build_sst(Skiplist& table) {
+  Sstbuild builder(Global_::Block_SIZE, true);
+  bool     empty = true;
+  for (auto it = table.begin(); it != table.end(); ++it) {
+    builder.add(it.getValue().first, it.getValue().second, it.getseq());
+    empty = false;
+  }
+  if (empty) {
+    return nullptr;
+  }
+  size_t sst_id = next_sst_id_++;
+  return builder.build(block_cache_, sst_dir_ + "/" + std::to_string(sst_id) + ".sst", sst_id);
+}
+
+MemTableIterator MemTable::begin(uint64_t transaction_id) {
+  std::vector<SkiplistIterator> tables;
+  auto                          version = current_version();
+  tables.push_back(version->active->sorted_view()->begin());
+  for (const auto& fixed_table : version->immutables) {
+    tables.push_back(fixed_table->begin());
+  }
+  return MemTableIterator(std::move(tables), transaction_id);
 }
 MemTableIterator MemTable::end() {
-  return MemTableIterator(fixed_tables.end()->get()->end(), 0);
+  return MemTableIterator(std::vector<SkiplistIterator>{}, 0);
 }
 // 迭代器
 
 MemTableIterator MemTable::prefix_serach(const std::string& key, uint64_t transaction_id) {
-  std::vector<SerachIterator>         iter;
-  std::shared_lock<std::shared_mutex> lock(cur_lock_);
-  if (!current_table) {
+  // 每张表只定位一次前缀的起点, 之后由归并游标在 ++ 时逐条推进, 不预先收集匹配的条目;
+  // 游标返回每个 key 可见的最新版本及其真实的 transaction_id
+  std::vector<SkiplistIterator> tables;
+  auto                          version = current_version();
+  if (!version->active) {
     throw std::runtime_error("current_table is null");
   }
-  for (auto begin = current_table->prefix_serach_begin(key);
-       begin != current_table->prefix_serach_end(key); ++begin) {
-    iter.push_back(
-        SerachIterator(begin.getValue().first, begin.getValue().second, transaction_id, 0, 0));
-  }
-  lock.unlock();
-  std::shared_lock<std::shared_mutex> second_lock(fix_lock_);
-  if (fixed_tables.empty()) {
-    return MemTableIterator(iter, transaction_id);
-  }
-  for (const auto& fixed_table : fixed_tables) {
-    for (auto begin = fixed_table->prefix_serach_begin(key);
-         begin != fixed_table->prefix_serach_end(key); ++begin) {
-      iter.push_back(
-          SerachIterator(begin.getValue().first, begin.getValue().second, transaction_id, 0, 0));
-    }
+  tables.push_back(version->active->prefix_range(key, transaction_id).first);
+  for (const auto& fixed_table : version->immutables) {
+    tables.push_back(fixed_table->prefix_range(key, transaction_id).first);
   }
-  return MemTableIterator(iter, transaction_id);
+  return MemTableIterator(std::move(tables), transaction_id, key);
 }
@@ -1,9 +1,15 @@
 #include "../../include/Block.h"
 #include "../../include/BlockIterator.h"
+#include "../../include/Compression.h"
+#include "../../include/Varint.h"
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
 #include <iostream>
+#include <optional>
+#include <random>
+#include <tuple>
+#include <vector>
 
 class BlockTest : public ::testing::Test {
  protected:
@@ -49,6 +55,25 @@ TEST_F(BlockTest, EncodeAndDecode) {
   EXPECT_EQ(decoded->get_value_binary("key2").value(), "value2");
 }
 
+// 测试迭代器的 key/value 视图直接指向 Block 的数据
+TEST_F(BlockTest, IteratorViews) {
+  block->add_entry("key1", "value1", 3);
+  block->add_entry("key2", "", 2);
+
+  auto it = block->begin();
+  EXPECT_EQ(it.key(), "key1");
+  EXPECT_EQ(it.value(), "value1");
+  EXPECT_EQ(it.tranc_id(), 3);
+  ++it;
+  EXPECT_EQ(it.key(), "key2");
+  EXPECT_TRUE(it.value().empty());
+  // 视图在迭代器前进后仍指向 Block 中原来的条目
+  std::string_view first = block->begin().key();
+  ++it;
+  EXPECT_EQ(first, "key1");
+  EXPECT_TRUE(it.is_end());
+}
+
 // 测试获取首尾键
 TEST_F(BlockTest, FirstAndLastKey) {
   block->add_entry("key1", "value1", 0);
@@ -154,7 +179,350 @@ TEST_F(BlockTest, SizeLimit) {
 // 测试空块
 TEST_F(BlockTest, EmptyBlock) {
   EXPECT_TRUE(block->is_empty());
-  EXPECT_EQ(block->get_cur_size(), 2);
+  // 空块只有尾部: v1 是条目数, v2 是条目数、重启间隔、校验和类型、格式版本和格式标记,
+  // v3 另有基准事务id和标志
+  EXPECT_EQ(Block(4096, Block::Format::kV1).get_cur_size(), 2);
+  EXPECT_EQ(Block(4096, Block::Format::kV2).get_cur_size(), 10);
+  EXPECT_EQ(block->get_cur_size(), 19);
+}
+
+// 测试校验和: v2 用 CRC32C 并记录在尾部, v1 仍是 std::hash; 损坏的块在校验时被发现
+TEST_F(BlockTest, Checksum) {
+  Block v1(4096, Block::Format::kV1);
+  for (int i = 10; i < 60; ++i) {
+    block->add_entry("key" + std::to_string(i), "value" + std::to_string(i), 0);
+    v1.add_entry("key" + std::to_string(i), "value" + std::to_string(i), 0);
+  }
+  auto encoded = block->encode();
+  auto decoded = Block::decode(encoded);
+  EXPECT_EQ(decoded->checksum_type(), Global_::ChecksumType::kCrc32c);
+  EXPECT_EQ(Block::decode(v1.encode())->checksum_type(), Global_::ChecksumType::kStdHash);
+
+  // 条目区中的一个字节被改写
+  auto corrupted = encoded;
+  corrupted[3] ^= 0x01;
+  EXPECT_THROW(Block::decode(corrupted), std::runtime_error);
+  // 跳过校验时照常解码
+  EXPECT_NO_THROW(Block::decode(corrupted, true, false));
+  // 校验和本身被改写
+  corrupted = encoded;
+  corrupted.back() ^= 0x80;
+  EXPECT_THROW(Block::decode(corrupted), std::runtime_error);
+  EXPECT_EQ(Block::decode(corrupted, true, false)->get_value_binary("key17").value(), "value17");
+}
+
+// 测试前缀压缩的 v2/v3 格式: 跨越多个重启点的查找和遍历, 以及 v1 块仍然可以读取
+TEST_F(BlockTest, PrefixCompressedFormat) {
+  auto legacy = std::make_shared<Block>(1 << 16, Block::Format::kV1);
+  auto prefix = std::make_shared<Block>(1 << 16, Block::Format::kV2);
+  auto packed = std::make_shared<Block>(1 << 16);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back("user_profile_" + std::to_string(1000 + i));
+    // 每个 key 两个版本, 新的在前
+    for (uint64_t tranc_id : {2, 1}) {
+      std::string value = "v" + std::to_string(i) + "_" + std::to_string(tranc_id);
+      ASSERT_TRUE(legacy->add_entry(keys.back(), value, tranc_id));
+      ASSERT_TRUE(prefix->add_entry(keys.back(), value, tranc_id));
+      ASSERT_TRUE(packed->add_entry(keys.back(), value, tranc_id));
+    }
+  }
+  auto legacy_encoded = legacy->encode();
+  auto prefix_encoded = prefix->encode();
+  auto packed_encoded = packed->encode();
+  EXPECT_LT(prefix_encoded.size(), legacy_encoded.size() * 3 / 4);
+  EXPECT_LT(packed_encoded.size(), prefix_encoded.size() * 3 / 4);
+
+  for (const auto& encoded : {legacy_encoded, prefix_encoded, packed_encoded}) {
+    auto decoded = Block::decode(encoded);
+    EXPECT_EQ(decoded->num_entries(), 200);
+    EXPECT_EQ(decoded->get_first_and_last_key(), std::make_pair(keys.front(), keys.back()));
+    for (int i = 0; i < 100; i++) {
+      EXPECT_EQ(decoded->get_idx_binary(keys[i], 2), static_cast<size_t>(i * 2));
+      EXPECT_EQ(decoded->get_idx_binary(keys[i], 1), static_cast<size_t>(i * 2 + 1));
+    }
+    EXPECT_FALSE(decoded->get_idx_binary("user_profile_0999", 2).has_value());
+    EXPECT_FALSE(decoded->get_idx_binary("user_profile_1100", 2).has_value());
+
+    int count = 0;
+    for (auto it = decoded->begin(); !it.is_end(); ++it, ++count) {
+      EXPECT_EQ(it.key(), keys[count / 2]);
+      EXPECT_EQ(it.tranc_id(), count % 2 == 0 ? 2 : 1);
+    }
+    EXPECT_EQ(count, 200);
+
+    // 从区间中间开始的迭代器
+    auto it = decoded->get_iterator(keys[37], 1);
+    EXPECT_EQ(it.getIndex(), 75);
+    EXPECT_EQ(it.value(), "v37_1");
+    ++it;
+    EXPECT_EQ(it.key(), keys[38]);
+
+    auto range = decoded->get_prefix_iterator("user_profile_105", 2);
+    ASSERT_TRUE(range.has_value());
+    std::vector<std::string> found;
+    for (auto begin = range->first; *begin != *range->second; ++(*begin)) {
+      found.push_back(begin->getValue().first);
+    }
+    EXPECT_EQ(found.size(), 20);
+    EXPECT_EQ(found.front(), "user_profile_1050");
+  }
+  EXPECT_EQ(Block::decode(legacy_encoded)->format(), Block::Format::kV1);
+  EXPECT_EQ(Block::decode(prefix_encoded)->format(), Block::Format::kV2);
+  EXPECT_EQ(Block::decode(packed_encoded)->format(), Block::Format::kV3);
+}
+
+// 测试变长整数: 快速路径和逐字节路径的结果相同, 截断和过长的编码被拒绝
+TEST_F(BlockTest, Varint) {
+  std::vector<uint64_t> values = {0, 1, 127, 128, 300, 16383, 16384, (1ull << 32) - 1, 1ull << 56,
+                                  UINT64_MAX};
+  for (uint64_t value : values) {
+    uint8_t buf[16] = {};
+    size_t  length  = put_varint(buf, value) - buf;
+    EXPECT_EQ(length, varint_length(value));
+    // 后面有足够字节时走快速路径, 刚好结束时逐字节解码
+    for (size_t limit : {sizeof(buf), length}) {
+      uint64_t decoded = 0;
+      EXPECT_EQ(get_varint(buf, buf + limit, &decoded), buf + length);
+      EXPECT_EQ(decoded, value);
+    }
+    uint64_t decoded = 0;
+    EXPECT_EQ(get_varint(buf, buf + length - 1, &decoded), nullptr);
+  }
+  uint8_t overlong[12];
+  std::fill(std::begin(overlong), std::end(overlong), 0x80);
+  overlong[11] = 0;
+  uint64_t decoded;
+  EXPECT_EQ(get_varint(overlong, overlong + sizeof(overlong), &decoded), nullptr);
+  for (int64_t delta : std::vector<int64_t>{0, 1, -1, 63, -64, INT64_MAX, INT64_MIN}) {
+    EXPECT_EQ(zigzag_decode(zigzag_encode(delta)), delta);
+  }
+  EXPECT_EQ(zigzag_encode(-1), 1);
+  EXPECT_EQ(zigzag_encode(1), 2);
+}
+
+// 测试 v3 条目: 超过 64KB 的 key 和 value, 以及与基准相差很大或小于基准的事务id
+TEST_F(BlockTest, VarintEntries) {
+  auto        built = std::make_shared<Block>(1 << 20);
+  std::string large_key(70000, 'k');
+  std::string large_value(100000, 'v');
+
+  std::vector<std::tuple<std::string, std::string, uint64_t>> entries = {
+      {"a", "small", 1000},
+      {large_key, large_value, 1},
+      {large_key + "x", "after", UINT64_MAX},
+      {"z", "", 1001},
+  };
+  for (const auto& [key, value, tranc_id] : entries) {
+    ASSERT_TRUE(built->add_entry(key, value, tranc_id, true));
+  }
+  auto decoded = Block::decode(built->encode());
+  EXPECT_EQ(decoded->format(), Block::Format::kV3);
+  size_t index = 0;
+  for (auto it = decoded->begin(); !it.is_end(); ++it, ++index) {
+    const auto& [key, value, tranc_id] = entries[index];
+    EXPECT_EQ(it.key(), key);
+    EXPECT_EQ(it.value(), value);
+    EXPECT_EQ(it.tranc_id(), tranc_id);
+  }
+  EXPECT_EQ(index, entries.size());
+  EXPECT_EQ(decoded->get_idx_binary(large_key, 5), 1);
+  EXPECT_EQ(decoded->get_idx_binary(large_key + "x", UINT64_MAX), 2);
+  EXPECT_FALSE(decoded->get_idx_binary(large_key + "x", 5).has_value());
+
+  // 条目区中一个长度被改写成越界的值时抛出异常, 而不是读到块外
+  auto small = std::make_shared<Block>(4096);
+  ASSERT_TRUE(small->add_entry("key", "value", 7));
+  auto encoded = small->encode(false);
+  encoded[2]   = 0x7f;  // value 长度
+  EXPECT_THROW(Block::decode(encoded, false)->get_value_binary("key"), std::out_of_range);
+}
+
+// 测试解码出的块是缓冲区的只读视图, 并共享缓冲区的所有权
+TEST_F(BlockTest, ZeroCopyDecode) {
+  for (int i = 0; i < 40; i++) {
+    ASSERT_TRUE(block->add_entry("key" + std::to_string(100 + i), "value" + std::to_string(i), 0));
+  }
+  auto encoded = block->encode();
+  // 模拟一段 SST 区域: 块前后还有其他数据
+  auto region = std::make_shared<std::vector<uint8_t>>(16, 0);
+  region->insert(region->end(), encoded.begin(), encoded.end());
+  region->resize(region->size() + 16, 0);
+  const uint8_t* begin = region->data() + 16;
+  auto           view  = Block::decode(region, begin, encoded.size());
+  std::weak_ptr<std::vector<uint8_t>> weak = region;
+  region.reset();
+  EXPECT_FALSE(weak.expired());
+
+  auto it = view->get_iterator("key125");
+  ASSERT_FALSE(it.is_end());
+  EXPECT_EQ(it.value(), "value25");
+  auto value = it.value();
+  EXPECT_GE(reinterpret_cast<const uint8_t*>(value.data()), begin);
+  EXPECT_LT(reinterpret_cast<const uint8_t*>(value.data()), begin + encoded.size());
+  EXPECT_EQ(view->encode(), encoded);
+  EXPECT_THROW(view->add_entry("key999", "v", 0), std::logic_error);
+
+  it = BlockIterator();
+  view.reset();
+  EXPECT_TRUE(weak.expired());
+}
+
+// 内置 LZ 压缩: 空输入、不可压缩的数据、长重复串和重叠匹配都能还原; 数据被截断或长度不符时报错
+TEST_F(BlockTest, LzCodec) {
+  std::mt19937                      rng(7);
+  std::vector<std::vector<uint8_t>> inputs(5);
+  for (int i = 0; i < 5000; ++i) {
+    inputs[1].push_back(static_cast<uint8_t>(rng()));
+    inputs[2].push_back('a');
+    inputs[3].push_back(static_cast<uint8_t>("value-"[i % 6]));
+    inputs[4].push_back(static_cast<uint8_t>(i % 3 == 0 ? rng() % 4 : 'x'));
+  }
+  for (const auto& input : inputs) {
+    std::vector<uint8_t> compressed;
+    ASSERT_TRUE(compress(Global_::CompressionType::kLz, input.data(), input.size(), compressed));
+    EXPECT_EQ(decompress(Global_::CompressionType::kLz, compressed.data(), compressed.size(),
+                         input.size()),
+              input);
+    if (!input.empty()) {
+      EXPECT_THROW(decompress(Global_::CompressionType::kLz, compressed.data(),
+                              compressed.size() / 2, input.size()),
+                   std::runtime_error);
+    }
+    EXPECT_THROW(decompress(Global_::CompressionType::kLz, compressed.data(), compressed.size(),
+                            input.size() + 1),
+                 std::runtime_error);
+  }
+  std::vector<uint8_t> compressed;
+  compress(Global_::CompressionType::kLz, inputs[2].data(), inputs[2].size(), compressed);
+  EXPECT_LT(compressed.size(), inputs[2].size() / 50);
+}
+
+// 压缩块: 解码后与原始块一致, 损坏时校验失败; 压缩效果不好或算法不可用时存原始块
+TEST_F(BlockTest, CompressedBlock) {
+  Block v1(4096, Block::Format::kV1);
+  for (int i = 10; i < 60; ++i) {
+    std::string value = "the quick brown fox jumps over the lazy dog " + std::to_string(i % 4);
+    block->add_entry("key" + std::to_string(i), value, i);
+    v1.add_entry("key" + std::to_string(i), value, i);
+  }
+  for (auto* source : {block.get(), &v1}) {
+    auto raw     = source->encode();
+    auto encoded = source->encode(true, Global_::CompressionType::kLz);
+    EXPECT_LT(encoded.size(), raw.size() / 2);
+    auto decoded = Block::decode(encoded);
+    EXPECT_EQ(decoded->compression_type(), Global_::CompressionType::kLz);
+    EXPECT_EQ(decoded->format(), source->format());
+    EXPECT_EQ(decoded->encode(), raw);
+    EXPECT_TRUE(decoded->get_idx_binary("key42", 42).has_value());
+
+    encoded[encoded.size() / 2] ^= 0x10;
+    EXPECT_THROW(Block::decode(encoded), std::runtime_error);
+  }
+
+  // 随机的 value 压缩不到 COMPRESSION_MIN_SAVING_PERCENT, 存原始块
+  Block        random_block(4096);
+  std::mt19937 rng(11);
+  for (int i = 10; i < 30; ++i) {
+    std::string value(64, '\0');
+    for (auto& c : value) {
+      c = static_cast<char>(rng());
+    }
+    random_block.add_entry("key" + std::to_string(i), value, 0);
+  }
+  EXPECT_EQ(random_block.encode(true, Global_::CompressionType::kLz), random_block.encode());
+  EXPECT_EQ(Block::decode(random_block.encode(true, Global_::CompressionType::kLz))
+                ->compression_type(),
+            Global_::CompressionType::kNone);
+  if (!compression_supported(Global_::CompressionType::kZstd)) {
+    EXPECT_EQ(block->encode(true, Global_::CompressionType::kZstd), block->encode());
+  }
+}
+
+// 测试 lower_bound 的增量比较: 与逐条比较完整 key 的结果一致
+TEST_F(BlockTest, LowerBoundMatchesLinearScan) {
+  std::vector<std::tuple<std::string, uint64_t>> entries;
+  std::vector<std::string> keys = {"a",    "ab",   "abc",  "abd", "abda", "abdb", "ac",  "b",
+                                   "ba",   "baa",  "bab",  "bb",  "c",    "ca",   "caa", "cab",
+                                   "caba", "cabb", "cac",  "d",   "da",   "db",   "dba", "dbb",
+                                   "dc",   "e",    "eaaa", "eaab"};
+  for (const auto& key : keys) {
+    // 同一个 key 的多个版本, 新的在前
+    for (uint64_t tranc_id : {5, 3, 1}) {
+      entries.emplace_back(key, tranc_id);
+    }
+  }
+  std::vector<std::string> probes = {"",   "a",  "aa",  "abc", "abcd", "abd", "abdc", "b",  "bac",
+                                     "c",  "ca", "cab", "cb",  "d",    "dbc", "e",    "eaa", "f"};
+  for (auto format : {Block::Format::kV1, Block::Format::kV2, Block::Format::kV3}) {
+    auto built = std::make_shared<Block>(1 << 16, format);
+    for (const auto& [key, tranc_id] : entries) {
+      ASSERT_TRUE(built->add_entry(key, "v" + key + std::to_string(tranc_id), tranc_id));
+    }
+    auto decoded = Block::decode(built->encode());
+    for (const auto& probe : probes) {
+      for (uint64_t tranc_id : {0, 1, 2, 4, 5, 9}) {
+        std::optional<size_t> exact, begin, end;
+        for (size_t i = 0; i < entries.size(); i++) {
+          const auto& [key, version] = entries[i];
+          if (version > tranc_id) {
+            continue;
+          }
+          if (key == probe && !exact) {
+            exact = i;
+          }
+          if (key.starts_with(probe)) {
+            begin = begin.value_or(i);
+            end   = i + 1;
+          }
+        }
+        EXPECT_EQ(decoded->get_idx_binary(probe, tranc_id), exact) << probe << " " << tranc_id;
+        EXPECT_EQ(decoded->get_prefix_begin_idx_binary(probe, tranc_id), begin)
+            << probe << " " << tranc_id;
+        EXPECT_EQ(decoded->get_prefix_end_idx_binary(probe, tranc_id), end)
+            << probe << " " << tranc_id;
+      }
+    }
+  }
+}
+
+// 哈希索引的点查结果与二分查找相同, 包括不存在的 key、不可见的版本和跨区间的多个版本
+TEST_F(BlockTest, HashIndex) {
+  auto built = std::make_shared<Block>(1 << 20);
+  for (int i = 0; i < 500; ++i) {
+    // 每 7 个 key 有 20 个版本, 跨越重启点
+    int versions = i % 7 == 0 ? 20 : 3;
+    for (int v = versions; v >= 1; --v) {
+      ASSERT_TRUE(built->add_entry("key" + std::to_string(i * 2 + 1000), "v" + std::to_string(v),
+                                   i % 5 == 0 ? 0 : v));
+    }
+  }
+  auto plain   = Block::decode(built->encode());
+  auto indexed = Block::decode(built->encode(true, Global_::CompressionType::kNone, true));
+  EXPECT_FALSE(plain->has_hash_index());
+  ASSERT_TRUE(indexed->has_hash_index());
+  EXPECT_EQ(indexed->num_entries(), plain->num_entries());
+  for (int i = 900; i < 2100; ++i) {
+    auto key = "key" + std::to_string(i);
+    for (uint64_t tranc_id : {0, 1, 2, 3, 10, 25}) {
+      EXPECT_EQ(indexed->get_idx_binary(key, tranc_id), plain->get_idx_binary(key, tranc_id))
+          << key << " " << tranc_id;
+    }
+    EXPECT_EQ(indexed->get_value_binary(key), plain->get_value_binary(key)) << key;
+    EXPECT_EQ(indexed->KeyExists(key), plain->KeyExists(key)) << key;
+  }
+  // 压缩块解压后仍带有索引
+  auto compressed = Block::decode(built->encode(true, Global_::CompressionType::kLz, true));
+  EXPECT_TRUE(compressed->has_hash_index());
+  EXPECT_EQ(compressed->get_idx_binary("key1200", 25), plain->get_idx_binary("key1200", 25));
+
+  // 重启点太多时桶里存不下编号, 不建索引
+  auto large = std::make_shared<Block>(1 << 20);
+  for (int i = 0; i < 5000; ++i) {
+    ASSERT_TRUE(large->add_entry("key" + std::to_string(i + 10000), "v", 0));
+  }
+  EXPECT_FALSE(Block::decode(large->encode(true, Global_::CompressionType::kNone, true))
+                   ->has_hash_index());
 }
 
 TEST_F(BlockTest, RangeSearch) {
@@ -1,7 +1,13 @@
 #include "../../include/memtable.h"
+#include "../../include/MemTableRep.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <vector>
 #include <format>
 
@@ -48,6 +54,62 @@ TEST_F(MemtableTest, BatchOperations) {
     EXPECT_EQ(result.size(), 3);
 }
 
+// 批量读取按调用方的顺序返回, 并带回每个值实际的版本号
+TEST_F(MemtableTest, SortedGetBatch) {
+    for (int i = 0; i < 100; i++) {
+        memtable->put("key" + std::to_string(i), "old" + std::to_string(i), 1);
+    }
+    memtable->frozen_cur_table();
+    memtable->put("key5", "new5", 3);
+    memtable->remove("key7", 4);
+    memtable->put("key200", "v200", 2);
+
+    std::vector<std::string> keys = {"key7", "key200", "key5", "missing", "key42", "key5"};
+    auto result = memtable->get_batch(keys);
+    ASSERT_EQ(result.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(std::get<0>(result[i]), keys[i]);
+    }
+    EXPECT_FALSE(std::get<1>(result[0]).has_value());  // 活跃表中的删除标记
+    EXPECT_EQ(std::get<1>(result[1]).value(), "v200");
+    EXPECT_EQ(std::get<2>(result[1]).value(), 2);
+    EXPECT_EQ(std::get<1>(result[2]).value(), "new5");
+    EXPECT_EQ(std::get<2>(result[2]).value(), 3);
+    EXPECT_FALSE(std::get<1>(result[3]).has_value());
+    EXPECT_FALSE(std::get<2>(result[3]).has_value());
+    EXPECT_EQ(std::get<1>(result[4]).value(), "old42");
+    EXPECT_EQ(std::get<2>(result[4]).value(), 1);
+    EXPECT_EQ(std::get<1>(result[5]).value(), "new5");
+
+    // 读旧快照
+    auto snapshot = memtable->get_batch(keys, 2);
+    EXPECT_EQ(std::get<1>(snapshot[0]).value(), "old7");
+    EXPECT_EQ(std::get<1>(snapshot[2]).value(), "old5");
+    EXPECT_EQ(std::get<2>(snapshot[2]).value(), 1);
+}
+
+// 乱序批量插入测试
+TEST_F(MemtableTest, UnsortedBatchPut) {
+    std::vector<std::pair<std::string, std::string>> batch_data;
+    for (int i = 999; i >= 0; i--) {
+        batch_data.emplace_back("key" + std::to_string(i), "value" + std::to_string(i));
+    }
+    // 批内重复的 key 以后写入的为准
+    batch_data.emplace_back("key500", "latest");
+    memtable->put_batch(batch_data);
+
+    for (int i = 0; i < 1000; i++) {
+        auto result = memtable->get("key" + std::to_string(i));
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(result.value(), i == 500 ? "latest" : "value" + std::to_string(i));
+    }
+    // 已有数据之间的批量插入
+    memtable->put_batch({{"key5000", "a"}, {"key0", "b"}, {"key1x", "c"}});
+    EXPECT_EQ(memtable->get("key5000").value(), "a");
+    EXPECT_EQ(memtable->get("key0").value(), "b");
+    EXPECT_EQ(memtable->get("key1x").value(), "c");
+}
+
 // 删除操作测试
 TEST_F(MemtableTest, RemoveOperations) {
     // 普通删除
@@ -80,7 +142,401 @@ TEST_F(MemtableTest, TransactionIdTest) {
     auto it = memtable->cur_get("key1", 1);
     values.push_back(it.getValue().second);
     EXPECT_FALSE(values.empty());
-    EXPECT_EQ(values[0], "");
+    // 旧版本被保留, 事务 1 的快照读到 value1
+    EXPECT_EQ(values[0], "value1");
+    EXPECT_EQ(memtable->cur_get("key1", 2).getValue().second, "value2");
+    EXPECT_EQ(memtable->get("key1").value(), "value2");
+}
+
+// 归并游标的双向迭代测试
+TEST_F(MemtableTest, BidirectionalIteration) {
+    memtable->put("key1", "old1", 1);
+    memtable->put("key3", "value3", 1);
+    memtable->put("key5", "value5", 1);
+    memtable->frozen_cur_table();
+    memtable->put("key1", "new1", 4);
+    memtable->put("key2", "value2", 2);
+    memtable->remove("key3", 3);
+    memtable->put("key4", "value4", 6);
+
+    // 最新快照: key3 已删除
+    std::vector<std::string> keys;
+    for (auto it = memtable->begin(); it.valid(); ++it) {
+        keys.push_back(it.getValue().first);
+    }
+    EXPECT_EQ(keys, (std::vector<std::string>{"key1", "key2", "key4", "key5"}));
+
+    auto it = memtable->begin();
+    it.SeekToLast();
+    std::vector<std::string> reversed;
+    for (; it.valid(); it.Prev()) {
+        reversed.push_back(it.getValue().first);
+    }
+    EXPECT_EQ(reversed, (std::vector<std::string>{"key5", "key4", "key2", "key1"}));
+
+    it.SeekForPrev("key3");
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.getValue().first, "key2");
+    it.SeekForPrev("key1");
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.getValue().second, "new1");
+    EXPECT_EQ(it.getseq(), 4);
+
+    // 快照 2: 看到旧的 key1 和未删除的 key3, 看不到 key4
+    auto snapshot = memtable->begin(2);
+    snapshot.SeekToLast();
+    reversed.clear();
+    for (; snapshot.valid(); snapshot.Prev()) {
+        reversed.push_back(snapshot.getValue().first + "=" + snapshot.getValue().second);
+    }
+    EXPECT_EQ(reversed, (std::vector<std::string>{"key5=value5", "key3=value3", "key2=value2",
+                                                  "key1=old1"}));
+}
+
+// 数组和哈希表示: 点查、多版本、删除以及冻结后转成有序跳表
+TEST_F(MemtableTest, UnorderedRepSortedViewCache) {
+    for (auto type : {Global_::MemTableRepType::kVector, Global_::MemTableRepType::kHash}) {
+        auto rep = make_memtable_rep(type);
+        for (int i = 9; i >= 0; i--) {
+            rep->Insert("key" + std::to_string(i), "value" + std::to_string(i), 1);
+        }
+        // 两次写入之间共用同一份排序视图, 写入后重建
+        auto view = rep->sorted_view();
+        EXPECT_EQ(rep->sorted_view(), view);
+        rep->Insert("key10", "value10", 1);
+        auto rebuilt = rep->sorted_view();
+        EXPECT_NE(rebuilt, view);
+        int count = 0;
+        for (auto it = rebuilt->begin(); it != rebuilt->end(); ++it) {
+            count++;
+        }
+        EXPECT_EQ(count, 11);
+        EXPECT_EQ(rep->prefix_range("key1").first.key(), "key1");
+        EXPECT_EQ(rep->sorted_view(), rebuilt);
+    }
+}
+
+TEST_F(MemtableTest, AlternativeReps) {
+    for (auto type : {Global_::MemTableRepType::kVector, Global_::MemTableRepType::kHash,
+                      Global_::MemTableRepType::kArt, Global_::MemTableRepType::kPartitioned}) {
+        auto table = std::make_shared<MemTable>(type);
+        for (int i = 99; i >= 0; i--) {
+            table->put("key" + std::to_string(i), "value" + std::to_string(i), 1);
+        }
+        table->put("key5", "new5", 3);
+        table->put("key7", "dup", 1);
+        table->remove("key9", 2);
+        table->put_batch({{"batch2", "b2"}, {"batch1", "b1"}}, 1);
+
+        EXPECT_EQ(table->get("key5").value(), "new5");
+        EXPECT_EQ(table->cur_get("key5", 2).getValue().second, "value5");
+        EXPECT_EQ(table->get("key7").value(), "dup");  // 同一版本以后写入的为准
+        auto positioned = table->cur_get("key50", 1);
+        ASSERT_TRUE(positioned.valid());
+        EXPECT_EQ(positioned.getValue().second, "value50");
+        if (type == Global_::MemTableRepType::kVector || type == Global_::MemTableRepType::kHash) {
+            // 无序的表示只做点查, 游标不能移动
+            ++positioned;
+            EXPECT_FALSE(positioned.valid());
+        } else {
+            // 有序的表示的定位游标按 key 的顺序移动, 也可以重新定位
+            ++positioned;
+            EXPECT_EQ(positioned.key(), "key51");
+            positioned.Prev();
+            positioned.Prev();
+            EXPECT_EQ(positioned.key(), "key5");
+            positioned.Seek("key60");
+            EXPECT_EQ(positioned.key(), "key60");
+            positioned.SeekToLast();
+            EXPECT_EQ(positioned.key(), "key99");
+        }
+        EXPECT_FALSE(table->get("key9").has_value());
+        EXPECT_EQ(table->get("batch1").value(), "b1");
+
+        // 活跃表的范围查询通过排序视图完成
+        auto iter = table->prefix_serach("key1");
+        int count = 0;
+        for (; iter.valid(); ++iter) {
+            count++;
+        }
+        EXPECT_EQ(count, 11);
+
+        table->frozen_cur_table();
+        EXPECT_EQ(table->fix_get("key5", 2).getValue().second, "value5");
+        EXPECT_EQ(table->get("key7").value(), "dup");
+        EXPECT_FALSE(table->get("key9").has_value());
+        std::vector<std::string> keys;
+        for (auto it = table->begin(); it.valid(); ++it) {
+            keys.push_back(it.getValue().first);
+        }
+        EXPECT_EQ(keys.size(), 101);
+        EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    }
+
+    // 哈希表示支持多写者并发插入
+    auto table = std::make_shared<MemTable>(Global_::MemTableRepType::kHash);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&table, t]() {
+            for (int i = 0; i < 1000; i++) {
+                table->put_mutex("t" + std::to_string(t) + "_" + std::to_string(i), "v");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < 4; t++) {
+        EXPECT_TRUE(table->get("t" + std::to_string(t) + "_999").has_value());
+    }
+}
+
+// 按范围分片的活跃表: 不同范围的写者并发写入, 冻结和遍历时仍是一张有序的表
+TEST_F(MemtableTest, PartitionedConcurrentWrites) {
+    auto table = std::make_shared<MemTable>(Global_::MemTableRepType::kPartitioned);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&table, t]() {
+            // 每个线程的 key 以不同的字符开头, 落在不同的分片
+            std::string prefix(1, static_cast<char>('a' + t * 3));
+            for (int i = 0; i < 1000; i++) {
+                table->put_mutex(prefix + std::to_string(i), "v" + std::to_string(i), 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    table->put("a5", "new", 2);
+    table->remove("d7", 2);
+    EXPECT_EQ(table->get("a5").value(), "new");
+    EXPECT_EQ(table->cur_get("a5", 1).getValue().second, "v5");
+    EXPECT_FALSE(table->get("d7").has_value());
+    EXPECT_EQ(table->get("v999").value(), "v999");
+
+    auto count_prefix = [&](const std::string& prefix) {
+        int count = 0;
+        for (auto iter = table->prefix_serach(prefix); iter.valid(); ++iter) {
+            count++;
+        }
+        return count;
+    };
+    EXPECT_EQ(count_prefix("a1"), 111);
+    EXPECT_EQ(count_prefix(""), 8 * 1000 - 1);
+
+    table->frozen_cur_table();
+    EXPECT_EQ(table->get("a5").value(), "new");
+    EXPECT_FALSE(table->get("d7").has_value());
+    std::vector<std::string> keys;
+    for (auto it = table->begin(); it.valid(); ++it) {
+        keys.push_back(it.getValue().first);
+    }
+    EXPECT_EQ(keys.size(), 8 * 1000 - 1);
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+// 共享长前缀的 key 使用 ART 表示
+TEST_F(MemtableTest, ArtSharedPrefixKeys) {
+    auto table = std::make_shared<MemTable>(Global_::MemTableRepType::kArt);
+    // 足够多的列让内部节点从 Node4 一路扩展到 Node256
+    for (int pk = 0; pk < 300; pk++) {
+        for (int col = 0; col < 3; col++) {
+            table->put("tenant/orders/" + std::to_string(pk) + "/c" + std::to_string(col),
+                       "v" + std::to_string(pk), 1);
+        }
+    }
+    table->put("tenant/orders", "table_meta", 1);
+    table->put("tenant/orders/1/c0", "new", 5);
+    table->remove("tenant/orders/1/c1", 4);
+    table->put("tenant/users/1/c0", "user", 1);
+
+    EXPECT_EQ(table->get("tenant/orders/1/c0").value(), "new");
+    EXPECT_EQ(table->cur_get("tenant/orders/1/c0", 4).getValue().second, "v1");
+    EXPECT_FALSE(table->get("tenant/orders/1/c1").has_value());
+    EXPECT_FALSE(table->get("tenant/orders/1/c9").has_value());
+    EXPECT_FALSE(table->get("tenant/orders/1").has_value());
+
+    // 前缀查询是一次子树定位; 与前缀相同的 key 也在范围内
+    auto count_prefix = [&](const std::string& prefix, uint64_t tid) {
+        int count = 0;
+        for (auto iter = table->prefix_serach(prefix, tid); iter.valid(); ++iter) {
+            EXPECT_EQ(iter.getValue().first.compare(0, prefix.size(), prefix), 0);
+            count++;
+        }
+        return count;
+    };
+    EXPECT_EQ(count_prefix("tenant/orders/1/", 0), 2);  // c1 已删除
+    EXPECT_EQ(count_prefix("tenant/orders/1/", 3), 3);
+    EXPECT_EQ(count_prefix("tenant/orders/12", 0), 3 + 10 * 3);
+    EXPECT_EQ(count_prefix("tenant/orders", 0), 1 + 300 * 3 - 1);
+    EXPECT_EQ(count_prefix("tenant/", 0), 1 + 300 * 3 - 1 + 1);
+    EXPECT_EQ(count_prefix("tenant/x", 0), 0);
+    EXPECT_EQ(count_prefix("", 0), 1 + 300 * 3 - 1 + 1);
+
+    // 冻结后转换成跳表, 顺序和版本保持不变
+    table->frozen_cur_table();
+    table->put("tenant/orders/1/c3", "c3", 6);
+    EXPECT_EQ(table->get("tenant/orders/1/c3").value(), "c3");
+    EXPECT_EQ(table->get("tenant/orders/1/c0").value(), "new");
+    EXPECT_FALSE(table->get("tenant/orders/1/c1").has_value());
+    EXPECT_EQ(count_prefix("tenant/orders/1/", 0), 3);
+    std::vector<std::string> keys;
+    for (auto it = table->begin(); it.valid(); ++it) {
+        keys.push_back(it.getValue().first);
+    }
+    EXPECT_EQ(keys.size(), 1 + 300 * 3 - 1 + 1 + 1);
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+// 前缀查询在各表之间逐条归并, 返回每个 key 真实的版本号
+TEST_F(MemtableTest, PrefixSearchMergesTables) {
+    memtable->put("a/1", "old", 1);
+    memtable->put("a/2", "old", 1);
+    memtable->put("a/3", "old", 1);
+    memtable->frozen_cur_table();
+    memtable->remove("a/2", 3);
+    memtable->put("a/3", "new", 4);
+    memtable->put("b/1", "other", 4);
+
+    auto collect = [&](uint64_t tid) {
+        std::vector<std::tuple<std::string, std::string, uint64_t>> result;
+        for (auto iter = memtable->prefix_serach("a/", tid); iter.valid(); ++iter) {
+            result.emplace_back(iter.key(), iter.value(), iter.getseq());
+        }
+        return result;
+    };
+    using Entry = std::tuple<std::string, std::string, uint64_t>;
+    // 活跃表中的删除标记遮蔽了不可变表中的旧值
+    EXPECT_EQ(collect(0), (std::vector<Entry>{{"a/1", "old", 1}, {"a/3", "new", 4}}));
+    EXPECT_EQ(collect(2),
+              (std::vector<Entry>{{"a/1", "old", 1}, {"a/2", "old", 1}, {"a/3", "old", 1}}));
+
+    auto iter = memtable->prefix_serach("a/");
+    iter.SeekToLast();
+    EXPECT_EQ(iter.key(), "a/3");
+    iter.Prev();
+    EXPECT_EQ(iter.key(), "a/1");
+    iter.Seek("0");
+    EXPECT_EQ(iter.key(), "a/1");
+    iter.SeekForPrev("z");
+    EXPECT_EQ(iter.key(), "a/3");
+    ++iter;
+    EXPECT_FALSE(iter.valid());
+}
+
+// 检查点文件保存所有表, 重启后并行加载恢复
+TEST_F(MemtableTest, FrozenTableKeyFilter) {
+    // 每张冻结的表各自建立过滤器, 查找时跳过不含该 key 的表
+    for (int table = 0; table < 3; table++) {
+        for (int i = 0; i < 1000; i++) {
+            memtable->put("t" + std::to_string(table) + "_" + std::to_string(i), "v", table + 1);
+        }
+        memtable->put("shared", "v" + std::to_string(table), table + 1);
+        memtable->frozen_cur_table();
+    }
+    EXPECT_EQ(memtable->get("t0_7").value(), "v");
+    EXPECT_EQ(memtable->get("t2_999").value(), "v");
+    EXPECT_FALSE(memtable->get("t3_0").has_value());
+    EXPECT_EQ(memtable->get("shared").value(), "v2");
+    EXPECT_EQ(memtable->fix_get("shared", 1).getValue().second, "v0");
+    EXPECT_EQ(memtable->fix_get("t1_5", 2).getValue().second, "v");
+    EXPECT_FALSE(memtable->fix_get("t1_5", 1).valid());
+    EXPECT_FALSE(memtable->fix_get("t9_5", 3).valid());
+}
+TEST_F(MemtableTest, ReadsDuringFreeze) {
+    // 写者不断写入并冻结, 读者不加锁, 已写入的 key 在冻结前后都必须能读到
+    std::atomic<int>  written{0};
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (int i = 0; i < 5000; i++) {
+            memtable->put_mutex("key" + std::to_string(i), "v" + std::to_string(i), i + 1);
+            written.store(i + 1, std::memory_order_release);
+            if (i % 100 == 99) {
+                memtable->frozen_cur_table();
+            }
+        }
+        done = true;
+    });
+    std::vector<std::thread> readers;
+    std::atomic<int>         missing{0};
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+            while (!done) {
+                int count = written.load(std::memory_order_acquire);
+                if (count == 0) {
+                    continue;
+                }
+                int i = (count * 7 + t) % count;
+                if (memtable->get("key" + std::to_string(i)) != "v" + std::to_string(i)) {
+                    missing++;
+                }
+                auto batch = memtable->get_batch({"key" + std::to_string(count - 1)});
+                if (!std::get<1>(batch[0]).has_value()) {
+                    missing++;
+                }
+            }
+        });
+    }
+    writer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(missing, 0);
+    EXPECT_EQ(memtable->get("key4999").value(), "v4999");
+    EXPECT_EQ(memtable->get_cur_size(), 0);
+}
+TEST_F(MemtableTest, CheckpointAndLoad) {
+    const std::string dir = "/root/LSM/tmp/checkpoint_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const std::string value(100, 'v');
+    // 第一张表足够大, 检查点文件会被分成多个块
+    for (int i = 0; i < 20000; i++) {
+        memtable->put("key" + std::to_string(i), value + std::to_string(i), 1);
+    }
+    memtable->put("key7", "new7", 3);
+    memtable->frozen_cur_table();
+    memtable->put("key8", "new8", 4);
+    memtable->remove("key9", 4);
+
+    memtable->checkpoint(dir);
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir),
+                            std::filesystem::directory_iterator()), 2);
+    // 不可变表不会重复写入, 活跃表的旧快照被替换
+    memtable->put("key10", "new10", 5);
+    memtable->checkpoint(dir);
+    EXPECT_FALSE(std::filesystem::exists(dir + "/1.ckpt"));
+    EXPECT_TRUE(std::filesystem::exists(dir + "/0.ckpt"));
+    EXPECT_TRUE(std::filesystem::exists(dir + "/2.ckpt"));
+
+    auto restored = std::make_shared<MemTable>();
+    restored->load_checkpoints(dir);
+    EXPECT_EQ(restored->get("key7").value(), "new7");
+    EXPECT_EQ(restored->fix_get("key7", 2).getValue().second, value + "7");
+    EXPECT_EQ(restored->get("key8").value(), "new8");
+    EXPECT_EQ(restored->get("key10").value(), "new10");
+    EXPECT_FALSE(restored->get("key9").has_value());
+    EXPECT_EQ(restored->get("key19999").value(), value + "19999");
+    EXPECT_EQ(restored->get_fixed_size(), memtable->get_total_size());
+
+    std::vector<std::pair<std::string, std::string>> expected;
+    std::vector<std::pair<std::string, std::string>> actual;
+    for (auto it = memtable->begin(); it.valid(); ++it) {
+        expected.push_back(it.getValue());
+    }
+    for (auto it = restored->begin(); it.valid(); ++it) {
+        actual.push_back(it.getValue());
+    }
+    EXPECT_EQ(actual, expected);
+
+    // 被损坏的数据块在加载时被发现
+    {
+        std::fstream file(dir + "/0.ckpt", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(1 << 20 | 17);
+        file.put('#');
+    }
+    EXPECT_THROW(std::make_shared<MemTable>()->load_checkpoints(dir), std::runtime_error);
+    std::filesystem::remove_all(dir);
 }
 
 // 表冻结和刷新测试
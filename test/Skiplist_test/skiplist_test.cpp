@@ -2,8 +2,12 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 
 class SkiplistTest : public ::testing::Test {
@@ -72,15 +76,282 @@ TEST_F(SkiplistTest, TransactionIdTest) {
     EXPECT_TRUE(skiplist->Insert("key1", "value1", 1));
     EXPECT_TRUE(skiplist->Insert("key1", "value2", 2));
     
+    // 旧版本被保留, 事务 1 的快照仍然读到 value1
     auto result1 = skiplist->Contain("key1", 1);
     EXPECT_TRUE(result1.has_value());
-    EXPECT_EQ(result1.value(), "value2");
+    EXPECT_EQ(result1.value(), "value1");
     
     auto result2 = skiplist->Contain("key1", 2);
     EXPECT_TRUE(result2.has_value());
     EXPECT_EQ(result2.value(), "value2");
 }
 
+// 多版本测试: 按 (key 升序, 事务ID 降序) 保留所有版本
+TEST_F(SkiplistTest, MultiVersionTest) {
+    EXPECT_TRUE(skiplist->Insert("key1", "v5", 5));
+    EXPECT_TRUE(skiplist->Insert("key1", "v1", 1));
+    EXPECT_TRUE(skiplist->Insert("key1", "v3", 3));
+    EXPECT_TRUE(skiplist->Insert("key0", "a", 4));
+    EXPECT_TRUE(skiplist->Insert("key2", "b", 2));
+    // 同一版本写入相同的值不会产生新节点
+    EXPECT_FALSE(skiplist->Insert("key1", "v3", 3));
+
+    // 每个快照读到版本号不大于它的最新版本
+    EXPECT_EQ(skiplist->Contain("key1").value(), "v5");
+    EXPECT_EQ(skiplist->Contain("key1", 6).value(), "v5");
+    EXPECT_EQ(skiplist->Contain("key1", 4).value(), "v3");
+    EXPECT_EQ(skiplist->Contain("key1", 2).value(), "v1");
+    EXPECT_EQ(skiplist->Get("key1", 3)->transaction_id, 3);
+    // key2 只有版本 2, 快照 1 看不到它
+    EXPECT_FALSE(skiplist->Contain("key2", 1).has_value());
+
+    // 迭代器按 key 升序, 同 key 内按版本从新到旧返回所有版本
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"key0", 4}, {"key1", 5}, {"key1", 3}, {"key1", 1}, {"key2", 2}};
+    size_t i = 0;
+    for (auto it = skiplist->begin(); it.valid(); ++it, ++i) {
+        ASSERT_LT(i, expected.size());
+        EXPECT_EQ(it.getValue().first, expected[i].first);
+        EXPECT_EQ(it.getseq(), expected[i].second);
+    }
+    EXPECT_EQ(i, expected.size());
+
+    // 删除会移除该 key 的所有版本
+    EXPECT_TRUE(skiplist->Delete("key1"));
+    EXPECT_FALSE(skiplist->Contain("key1", 2).has_value());
+    EXPECT_EQ(skiplist->getnodecount(), 2);
+}
+
+// 插入位置提示测试
+TEST_F(SkiplistTest, InsertHintTest) {
+    Skiplist::Splice splice;
+    // 单调递增的 key 沿着提示追加
+    for (int i = 0; i < 2000; i++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%06d", i);
+        EXPECT_TRUE(skiplist->InsertHint(key, "v" + std::to_string(i), 0, splice));
+    }
+    // 乱序的 key 和删除之后提示仍然正确
+    EXPECT_TRUE(skiplist->InsertHint("key000500x", "mid", 0, splice));
+    EXPECT_TRUE(skiplist->Delete("key001000"));
+    EXPECT_TRUE(skiplist->InsertHint("key001000", "again", 0, splice));
+    EXPECT_TRUE(skiplist->InsertHint("a", "first", 0, splice));
+    EXPECT_FALSE(skiplist->InsertHint("a", "first", 0, splice));
+
+    EXPECT_EQ(skiplist->Contain("key000500x").value(), "mid");
+    EXPECT_EQ(skiplist->Contain("key001000").value(), "again");
+    EXPECT_EQ(skiplist->Contain("key001999").value(), "v1999");
+    EXPECT_EQ(skiplist->getnodecount(), 2002);
+
+    std::string prev;
+    int count = 0;
+    for (auto it = skiplist->begin(); it.valid(); ++it) {
+        auto key = it.getValue().first;
+        EXPECT_LT(prev, key);
+        prev = key;
+        count++;
+    }
+    EXPECT_EQ(count, 2002);
+}
+
+// Insert 的提示与 InsertBatch 交替使用时, 索引层不会丢失其他路径插入的节点
+TEST_F(SkiplistTest, InsertHintMixedWithBatchTest) {
+    std::vector<std::string> keys;
+    for (int round = 0; round < 200; round++) {
+        // 单个插入的 key 递增, Insert 的提示底层一直停在表尾, 更高的层停在更靠前的节点
+        for (int i = 0; i < 10; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%06d", round * 100 + i * 10);
+            keys.push_back(key);
+            EXPECT_TRUE(skiplist->Insert(key, "single", 0));
+        }
+        // 批量插入的 key 穿插在本轮单个插入的 key 之间, 落在提示的高层区间里
+        std::vector<std::pair<std::string, std::string>> batch;
+        for (int i = 0; i < 9; i++) {
+            char key[16];
+            std::snprintf(key, sizeof(key), "key%06d", round * 100 + i * 10 + 5);
+            batch.emplace_back(key, "batch");
+            keys.push_back(key);
+        }
+        std::vector<const std::pair<std::string, std::string>*> sorted;
+        for (const auto& pair : batch) {
+            sorted.push_back(&pair);
+        }
+        skiplist->InsertBatch(sorted, 0);
+    }
+    EXPECT_EQ(skiplist->getnodecount(), keys.size());
+    // 每一层链接的节点数等于高度超过该层的节点数
+    std::vector<std::size_t> expected(MAX_LEVEL, 0);
+    for (const auto& key : keys) {
+        Node* node = skiplist->Get(key);
+        ASSERT_NE(node, nullptr);
+        for (int level = 0; level < node->height; level++) {
+            expected[level]++;
+        }
+    }
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        EXPECT_EQ(skiplist->level_node_count(level), expected[level]) << level;
+    }
+}
+
+// 反向迭代测试
+// 有序节点批量追加到表尾, 结果与逐个插入相同
+TEST_F(SkiplistTest, GetBatchTest) {
+    for (int i = 0; i < 1000; i += 2) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%06d", i);
+        skiplist->Insert(key, "v2", 2);
+        skiplist->Insert(key, "v1", 1);
+    }
+    std::vector<std::string> keys;
+    for (int i = 0; i < 1000; i++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%06d", i);
+        keys.push_back(key);
+    }
+    std::vector<const std::string*> sorted;
+    for (const auto& key : keys) {
+        sorted.push_back(&key);
+    }
+    std::vector<Node*> nodes;
+    skiplist->GetBatch(sorted, 0, nodes);
+    ASSERT_EQ(nodes.size(), keys.size());
+    for (int i = 0; i < 1000; i++) {
+        if (i % 2 == 0) {
+            ASSERT_NE(nodes[i], nullptr);
+            EXPECT_EQ(nodes[i]->key_, keys[i]);
+            EXPECT_EQ(nodes[i]->value_, "v2");
+        } else {
+            EXPECT_EQ(nodes[i], nullptr);
+        }
+    }
+    skiplist->GetBatch(sorted, 1, nodes);
+    EXPECT_EQ(nodes[500]->value_, "v1");
+    EXPECT_EQ(nodes[500]->transaction_id, 1);
+}
+TEST_F(SkiplistTest, RangeIndexTest) {
+    Skiplist table(MAX_LEVEL, "user/");
+    // 范围编号随 key 单调不减
+    std::vector<std::string> keys = {"a", "user", "user/", "user/\x01", "user/a", "user/a9",
+                                     "user/b", "user/\xff", "user0", "z"};
+    for (size_t i = 1; i < keys.size(); i++) {
+        EXPECT_LE(table.get_range_index(keys[i - 1]), table.get_range_index(keys[i]));
+    }
+    EXPECT_EQ(table.get_range_index("user/"), 0);
+    EXPECT_EQ(table.get_range_index("user/a"), 'a');
+    EXPECT_EQ(table.get_range_index("z"), Skiplist::MAX_RANGES - 1);
+}
+TEST_F(SkiplistTest, KeyFilterTest) {
+    // 建立过滤器之前总是返回 true
+    EXPECT_TRUE(skiplist->may_contain("absent"));
+    for (int i = 0; i < 10000; i++) {
+        skiplist->Insert("key" + std::to_string(i), "v2", 2);
+        skiplist->Insert("key" + std::to_string(i), "v1", 1);
+    }
+    skiplist->build_key_filter();
+    for (int i = 0; i < 10000; i++) {
+        EXPECT_TRUE(skiplist->may_contain("key" + std::to_string(i)));
+    }
+    int false_positive = 0;
+    for (int i = 0; i < 10000; i++) {
+        false_positive += skiplist->may_contain("missing" + std::to_string(i));
+    }
+    EXPECT_LT(false_positive, 300);
+}
+TEST_F(SkiplistTest, AppendSortedTest) {
+    std::vector<Node*> first;
+    std::vector<Node*> second;
+    for (int i = 0; i < 1000; i++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%06d", i);
+        auto& nodes = i < 500 ? first : second;
+        nodes.push_back(skiplist->AllocateNode(key, "new", 2));
+        nodes.push_back(skiplist->AllocateNode(key, "old", 1));
+    }
+    skiplist->AppendSorted(first);
+    skiplist->AppendSorted(second);
+
+    EXPECT_EQ(skiplist->getnodecount(), 2000);
+    EXPECT_EQ(skiplist->Contain("key000700").value(), "new");
+    EXPECT_EQ(skiplist->Contain("key000700", 1).value(), "old");
+    EXPECT_FALSE(skiplist->Contain("key001000").has_value());
+    // 追加之后仍然可以正常插入
+    EXPECT_TRUE(skiplist->Insert("key000250x", "mid", 1));
+    EXPECT_EQ(skiplist->Contain("key000250x").value(), "mid");
+    auto last = skiplist->begin();
+    last.SeekToLast();
+    EXPECT_EQ(last.key(), "key000999");
+}
+
+TEST_F(SkiplistTest, ReverseIteratorTest) {
+    for (int i = 0; i < 100; i++) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key%03d", i);
+        EXPECT_TRUE(skiplist->Insert(key, "v" + std::to_string(i)));
+    }
+    // 多个版本和同一版本的重复写入
+    EXPECT_TRUE(skiplist->Insert("key050", "new", 5));
+    EXPECT_TRUE(skiplist->Insert("key050", "again"));
+
+    auto it = skiplist->begin();
+    it.SeekToLast();
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.key(), "key099");
+
+    // 反向遍历的顺序与正向遍历相反
+    std::vector<std::pair<std::string, uint64_t>> forward;
+    for (auto f = skiplist->begin(); f.valid(); ++f) {
+        forward.emplace_back(std::string(f.key()), f.getseq());
+    }
+    std::vector<std::pair<std::string, uint64_t>> backward;
+    for (; it.valid(); it.Prev()) {
+        backward.emplace_back(std::string(it.key()), it.getseq());
+        if (it.key() == "key050" && it.getseq() == 0) {
+            EXPECT_EQ(it.value(), "again");  // 反向也只看到最后写入的值
+        }
+    }
+    std::reverse(backward.begin(), backward.end());
+    EXPECT_EQ(forward, backward);
+    EXPECT_EQ(forward.size(), 101);
+
+    it.SeekForPrev("key0505");
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.key(), "key050");
+    EXPECT_EQ(it.getseq(), 0);  // 同 key 最旧的版本
+    it.SeekForPrev("a");
+    EXPECT_FALSE(it.valid());
+    it.Seek("key0505");
+    ASSERT_TRUE(it.valid());
+    EXPECT_EQ(it.key(), "key051");
+}
+
+// 公共前缀与缓存前缀比较测试
+TEST_F(SkiplistTest, CommonPrefixOrderTest) {
+    skiplist = std::make_unique<Skiplist>(MAX_LEVEL, "tenant42/");
+    // 包含不带公共前缀的 key, 短 key, 以及只在第 8 个字节之后才不同的 key
+    std::vector<std::string> keys = {
+        "tenant42/order00000001", "tenant42/order00000002", "tenant42/",
+        "tenant42/a",             "tenant42/a" + std::string(1, '\0'),
+        "tenant41/zzz",           "tenant43/a",             "t",
+        "tenant42/\xff\xff",      "tenant42/order0000000",  "tenant42/order000000010"};
+    for (const auto& key : keys) {
+        EXPECT_TRUE(skiplist->Insert(key, "v_" + key));
+    }
+    std::sort(keys.begin(), keys.end());
+    size_t i = 0;
+    for (auto it = skiplist->begin(); it.valid(); ++it, ++i) {
+        ASSERT_LT(i, keys.size());
+        EXPECT_EQ(it.getValue().first, keys[i]);
+    }
+    EXPECT_EQ(i, keys.size());
+    for (const auto& key : keys) {
+        ASSERT_TRUE(skiplist->Contain(key).has_value());
+        EXPECT_EQ(skiplist->Contain(key).value(), "v_" + key);
+    }
+    EXPECT_FALSE(skiplist->Contain("tenant42/order").has_value());
+    EXPECT_EQ(skiplist->key_common_prefix(), "t");
+}
+
 // 测试内存大小统计
 TEST_F(SkiplistTest, SizeTest) {
     size_t initial_size = skiplist->get_size();
@@ -88,6 +359,71 @@ TEST_F(SkiplistTest, SizeTest) {
     EXPECT_GT(skiplist->get_size(), initial_size);
 }
 
+// 测试 Arena 内存统计
+TEST_F(SkiplistTest, ArenaMemoryUsageTest) {
+    size_t initial_usage = skiplist->memory_usage();
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_TRUE(skiplist->Insert("key" + std::to_string(i), "value" + std::to_string(i)));
+    }
+    // Arena 统计包含节点头和指针塔, 不应小于 key/value 的字节数
+    EXPECT_GT(skiplist->memory_usage(), initial_usage);
+    EXPECT_GE(skiplist->memory_usage(), skiplist->get_size());
+
+    // 覆盖写入后旧值仍然可以通过新值读到
+    EXPECT_TRUE(skiplist->Insert("key1", "a_much_longer_value_than_before"));
+    EXPECT_EQ(skiplist->Contain("key1").value(), "a_much_longer_value_than_before");
+    auto it = skiplist->get_iterator("key1");
+    EXPECT_TRUE(it.valid());
+    EXPECT_EQ(it.getValue().second, "a_much_longer_value_than_before");
+}
+
+// 多写者并发插入测试
+TEST_F(SkiplistTest, ConcurrentInsertTest) {
+    const int NUM_THREADS = 8;
+    const int PER_THREAD = 5000;
+    std::atomic_bool stop{false};
+    std::vector<std::thread> writers;
+    // 读者与写者同时运行, 读者不加锁
+    std::thread reader([this, &stop]() {
+        while (!stop.load()) {
+            auto result = skiplist->Contain("t0_k0");
+            if (result.has_value()) {
+                EXPECT_EQ(result.value(), "v0");
+            }
+        }
+    });
+    for (int t = 0; t < NUM_THREADS; t++) {
+        writers.emplace_back([this, t, PER_THREAD]() {
+            for (int i = 0; i < PER_THREAD; i++) {
+                skiplist->InsertConcurrently("t" + std::to_string(t) + "_k" + std::to_string(i),
+                                             "v" + std::to_string(i));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    stop = true;
+    reader.join();
+
+    EXPECT_EQ(skiplist->getnodecount(), NUM_THREADS * PER_THREAD);
+    // 最底层必须严格有序
+    std::string prev;
+    int count = 0;
+    for (auto it = skiplist->begin(); it.valid(); ++it) {
+        auto key = it.getValue().first;
+        EXPECT_LT(prev, key);
+        prev = key;
+        count++;
+    }
+    EXPECT_EQ(count, NUM_THREADS * PER_THREAD);
+    for (int t = 0; t < NUM_THREADS; t++) {
+        auto result = skiplist->Contain("t" + std::to_string(t) + "_k" + std::to_string(PER_THREAD - 1));
+        ASSERT_TRUE(result.has_value());
+        EXPECT_EQ(result.value(), "v" + std::to_string(PER_THREAD - 1));
+    }
+}
+
 // 性能测试
 TEST_F(SkiplistTest, PerformanceTest) {
     const int NUM_OPERATIONS = 1000000;  // 测试10万次操作
@@ -1,9 +1,12 @@
 #include "../../include/memtable.h"
 #include "../../include/SstableIterator.h"
 #include "../../include/Blockcache.h"
+#include "../../include/Compression.h"
 #include <gtest/gtest.h>
 #include <memory>
+#include <cstring>
 #include <filesystem>
+#include <format>
 #include <print>
 #include <string>
 #include <utility>
@@ -153,6 +156,182 @@ TEST_F(SstableTest, ReadMultipleBlocksAndCache) {
   }
 }
 
+// 块很小时点查要在多个 block 的首尾 key 之间二分, 每个 key 都要落在正确的 block 上
+TEST_F(SstableTest, PointLookupAcrossBlocks) {
+  if (std::filesystem::exists(tmp_path1))
+    std::filesystem::remove(tmp_path1);
+
+  Sstbuild builder(256, false);
+  auto     key_of = [](int i) { return std::format("pk{:05}", i * 2); };
+  for (int i = 0; i < 1000; ++i) {
+    builder.add(key_of(i), "v" + std::to_string(i), 0);
+  }
+  auto sst = builder.build(block_cache, tmp_path1, 3);
+  ASSERT_GT(sst->num_blocks(), 3u);
+  for (int i = 0; i < 1000; ++i) {
+    auto iter = sst->get_Iterator(key_of(i), 0);
+    ASSERT_TRUE(iter.valid()) << key_of(i);
+    EXPECT_EQ(iter.key(), key_of(i));
+    EXPECT_EQ(iter.value(), "v" + std::to_string(i));
+    // 奇数编号的 key 不存在, 可能落在两个 block 之间
+    EXPECT_FALSE(sst->KeyExists(std::format("pk{:05}", i * 2 + 1)));
+  }
+}
+
+// 新文件尾部记录 CRC32C 校验和类型; 没有校验和类型的旧文件仍按 std::hash 校验元数据块
+TEST_F(SstableTest, ChecksumFooter) {
+  if (std::filesystem::exists(tmp_path1))
+    std::filesystem::remove(tmp_path1);
+  if (std::filesystem::exists(tmp_path2))
+    std::filesystem::remove(tmp_path2);
+
+  Sstbuild builder(256, true);
+  for (int i = 0; i < 500; ++i) {
+    builder.add(std::format("ck{:04}", i), "v" + std::to_string(i), i + 1);
+  }
+  auto built = builder.build(block_cache, tmp_path1, 4);
+  auto sst   = Sstable::open(5, FileObj::open(tmp_path1, false), block_cache);
+  EXPECT_EQ(sst->get_checksum_type(), Global_::ChecksumType::kCrc32c);
+  EXPECT_EQ(sst->num_blocks(), built->num_blocks());
+  const std::pair<uint64_t, uint64_t> tranc_range{1, 500};
+  EXPECT_EQ(sst->get_tranc_id_range(), tranc_range);
+  EXPECT_TRUE(sst->read_block(sst->num_blocks() - 1)->get_idx_binary("ck0499", 500).has_value());
+
+  // 旧文件: 元数据块用 std::hash 校验, 尾部没有校验和类型、版本和魔数
+  auto bytes  = FileObj::open(tmp_path1, false).read_to_slice(0, built->get_sst_size());
+  auto meta   = BlockMeta::encode_meta_to_slice(sst->block_metas, Global_::ChecksumType::kStdHash);
+  size_t tail   = sizeof(uint8_t) * 2 + sizeof(uint32_t);
+  size_t footer = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 2;
+  uint32_t meta_at;
+  std::memcpy(&meta_at, bytes.data() + bytes.size() - tail - footer, sizeof(uint32_t));
+  std::copy(meta.begin(), meta.end(), bytes.begin() + meta_at);
+  bytes.resize(bytes.size() - tail);
+  FileObj::create_and_write(tmp_path2, bytes);
+
+  auto legacy = Sstable::open(6, FileObj::open(tmp_path2, false), block_cache);
+  EXPECT_EQ(legacy->get_checksum_type(), Global_::ChecksumType::kStdHash);
+  EXPECT_EQ(legacy->get_tranc_id_range(), tranc_range);
+  EXPECT_EQ(legacy->get_first_key(), "ck0000");
+  EXPECT_EQ(legacy->get_last_key(), "ck0499");
+  auto block_idx = legacy->find_block_idx("ck0250");
+  ASSERT_TRUE(block_idx.has_value());
+  EXPECT_TRUE(legacy->read_block(block_idx.value())->get_idx_binary("ck0250", 500).has_value());
+}
+
+// 数据块按层选择的算法压缩写入并附带哈希索引, 读出时解压; 缓存中是解压后的块
+TEST_F(SstableTest, CompressedBlocks) {
+  if (std::filesystem::exists(tmp_path1))
+    std::filesystem::remove(tmp_path1);
+
+  Sstbuild builder(4096, false);
+  size_t   raw_bytes = 0;
+  for (int i = 0; i < 2000; ++i) {
+    std::string key   = std::format("ck{:05}", i);
+    std::string value = "text heavy value repeated for block " + std::to_string(i / 100);
+    raw_bytes += key.size() + value.size();
+    builder.add(key, value, 0);
+  }
+  auto sst = builder.build(block_cache, tmp_path1, 7);
+  // 不压缩时每个条目还要存长度和事务id, 文件比 key 和 value 的总长度更大
+  EXPECT_LT(sst->get_sst_size(), raw_bytes);
+  auto block = sst->read_block(0);
+  EXPECT_EQ(block->compression_type(), compression_for_level(0));
+  EXPECT_TRUE(block->has_hash_index());
+  EXPECT_EQ(sst->read_block(0), block);
+  for (int i = 0; i < 2000; i += 97) {
+    auto iter = sst->get_Iterator(std::format("ck{:05}", i), 0);
+    ASSERT_TRUE(iter.valid());
+    EXPECT_EQ(iter.value(), "text heavy value repeated for block " + std::to_string(i / 100));
+  }
+}
+
+// 后台线程把冻结的表依次刷成 SST, 读者在 SST 中仍能读到数据
+TEST_F(SstableTest, BackgroundFlush) {
+  const std::string sst_dir = "/root/LSM/tmp/flush_test";
+  std::filesystem::remove_all(sst_dir);
+  std::filesystem::create_directories(sst_dir);
+
+  memtable->start_flush_thread(block_cache, sst_dir, 100);
+  // 冻结的表多于 MAX_IMMUTABLE_MEMTABLES 时写者会等待刷盘
+  const int rounds = Global_::MAX_IMMUTABLE_MEMTABLES + 2;
+  for (int round = 0; round < rounds; ++round) {
+    for (int i = 0; i < 200; ++i) {
+      memtable->put("key" + std::to_string(round * 100 + i), "v" + std::to_string(round),
+                    round + 1);
+    }
+    if (round == rounds - 1) {
+      memtable->remove("key5", round + 1);
+    }
+    memtable->frozen_cur_table();
+  }
+  memtable->wait_for_flush();
+
+  EXPECT_EQ(memtable->get_fixed_size(), 0u);
+  auto ssts = memtable->get_flushed_ssts();
+  ASSERT_EQ(ssts.size(), static_cast<size_t>(rounds));
+  EXPECT_EQ(ssts.front()->get_sst_id(), 100u + rounds - 1);
+  for (int round = 0; round < rounds; ++round) {
+    EXPECT_TRUE(std::filesystem::exists(sst_dir + "/" + std::to_string(100 + round) + ".sst"));
+  }
+
+  // key 重叠时以较新的 SST 为准, 删除标记同样生效
+  EXPECT_EQ(memtable->get("key0").value(), "v0");
+  EXPECT_EQ(memtable->get("key150").value(), "v1");
+  EXPECT_EQ(memtable->get("key" + std::to_string((rounds - 1) * 100 + 199)).value(),
+            "v" + std::to_string(rounds - 1));
+  EXPECT_FALSE(memtable->get("key5").has_value());
+  EXPECT_FALSE(memtable->get("missing").has_value());
+  // 批量读取同样回退到 SST, 并返回条目实际的版本号
+  auto batch = memtable->get_batch({"key150", "key5", "key0"});
+  EXPECT_EQ(std::get<1>(batch[0]).value(), "v1");
+  EXPECT_EQ(std::get<2>(batch[0]).value(), 2u);
+  EXPECT_FALSE(std::get<1>(batch[1]).has_value());
+  EXPECT_EQ(std::get<1>(batch[2]).value(), "v0");
+
+  // 刷盘线程运行时不可变表只由它删除, 同步刷盘被拒绝
+  Sstbuild sync_build(Global_::Block_SIZE, true);
+  EXPECT_THROW(memtable->flush(sync_build), std::logic_error);
+  EXPECT_THROW(memtable->flushsync(sync_build), std::logic_error);
+
+  memtable->stop_flush_thread();
+  std::filesystem::remove_all(sst_dir);
+}
+
+// 刷盘线程运行时加载的检查点表同样会被刷盘
+TEST_F(SstableTest, FlushLoadedCheckpoints) {
+  const std::string ckpt_dir = "/root/LSM/tmp/flush_ckpt";
+  const std::string sst_dir  = "/root/LSM/tmp/flush_ckpt_sst";
+  for (const auto& dir : {ckpt_dir, sst_dir}) {
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+  }
+  const int rounds = 3;
+  {
+    MemTable source;
+    for (int round = 0; round < rounds; ++round) {
+      for (int i = 0; i < 100; ++i) {
+        source.put("key" + std::to_string(round * 100 + i), "v" + std::to_string(round),
+                   round + 1);
+      }
+      source.frozen_cur_table();
+    }
+    source.checkpoint(ckpt_dir);
+  }
+
+  memtable->start_flush_thread(block_cache, sst_dir);
+  memtable->load_checkpoints(ckpt_dir);
+  memtable->wait_for_flush();
+  EXPECT_EQ(memtable->get_fixed_size(), 0u);
+  EXPECT_EQ(memtable->get_flushed_ssts().size(), static_cast<size_t>(rounds));
+  EXPECT_EQ(memtable->get("key0").value(), "v0");
+  EXPECT_EQ(memtable->get("key150").value(), "v1");
+  EXPECT_EQ(memtable->get("key299").value(), "v2");
+
+  memtable->stop_flush_thread();
+  std::filesystem::remove_all(ckpt_dir);
+  std::filesystem::remove_all(sst_dir);
+}
+
 // Collect keys from [begin, end) and verify prefix
 static std::vector<std::string> collect_prefix_keys(const std::shared_ptr<BlockIterator>& begin,
                                                     const std::shared_ptr<BlockIterator>& end,
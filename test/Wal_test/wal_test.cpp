@@ -0,0 +1,283 @@
+#include "../../include/Crc32c.h"
+#include "../../include/Wal.h"
+#include "../../include/Blockcache.h"
+#include "../../include/SstableIterator.h"
+#include "../../include/memtable.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WalTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::filesystem::create_directories(dir);
+    remove_wal();
+  }
+  void TearDown() override { remove_wal(); }
+
+  // memtable 写的日志段 <path>.<编号>, 按编号排序
+  std::vector<std::string> segments() const {
+    std::vector<std::pair<uint64_t, std::string>> found;
+    std::string                                   prefix = "lsm_test.wal.";
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+      std::string name = entry.path().filename().string();
+      if (name.starts_with(prefix)) {
+        found.emplace_back(std::stoull(name.substr(prefix.size())), entry.path().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> paths;
+    for (const auto& segment : found) {
+      paths.push_back(segment.second);
+    }
+    return paths;
+  }
+  size_t segment_records() const {
+    size_t count = 0;
+    for (const auto& segment : segments()) {
+      count += Wal::read(segment).size();
+    }
+    return count;
+  }
+  void remove_wal() const {
+    std::filesystem::remove(path);
+    for (const auto& segment : segments()) {
+      std::filesystem::remove(segment);
+    }
+  }
+
+  std::string dir  = "/root/LSM/tmp";
+  std::string path = "/root/LSM/tmp/lsm_test.wal";
+};
+
+// 写入的记录可以按顺序读回, 删除记录的 value 为空
+TEST_F(WalTest, WriteAndRead) {
+  {
+    Wal wal(path);
+    wal.add("key1", "value1", 1);
+    wal.add("key2", "", 2);
+    wal.add_batch({{"batch1", "b1"}, {"batch2", "b2"}}, 3);
+  }
+  auto records = Wal::read(path);
+  ASSERT_EQ(records.size(), 4u);
+  EXPECT_EQ(records[0].key, "key1");
+  EXPECT_EQ(records[0].value, "value1");
+  EXPECT_EQ(records[0].transaction_id, 1u);
+  EXPECT_EQ(records[1].key, "key2");
+  EXPECT_TRUE(records[1].value.empty());
+  EXPECT_EQ(records[3].key, "batch2");
+  EXPECT_EQ(records[3].transaction_id, 3u);
+
+  // 追加打开同一个文件, 新记录排在后面
+  {
+    Wal wal(path, Global_::WalSyncMode::kNone);
+    wal.add("key3", "value3", 4);
+  }
+  records = Wal::read(path);
+  ASSERT_EQ(records.size(), 5u);
+  EXPECT_EQ(records.back().key, "key3");
+}
+
+// 尾部被截断或损坏的记录在读取时被丢弃
+TEST_F(WalTest, TornTail) {
+  {
+    Wal wal(path);
+    for (int i = 0; i < 10; i++) {
+      wal.add("key" + std::to_string(i), "value" + std::to_string(i), i);
+    }
+  }
+  auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - 3);
+  EXPECT_EQ(Wal::read(path).size(), 9u);
+
+  // 翻转第 5 条记录中的一个字节, 它和之后的记录都不再可信
+  auto record_size = size / 10;
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(record_size * 4 + record_size - 1);
+    file.put('#');
+  }
+  EXPECT_EQ(Wal::read(path).size(), 4u);
+  EXPECT_TRUE(Wal::read(path + ".missing").empty());
+}
+
+// 并发写者组成提交组, 所有记录都完整写入
+TEST_F(WalTest, GroupCommit) {
+  for (auto mode : {Global_::WalSyncMode::kPerBatch, Global_::WalSyncMode::kPeriodic}) {
+    std::filesystem::remove(path);
+    {
+      Wal                      wal(path, mode, std::chrono::milliseconds(5));
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&wal, t]() {
+          for (int i = 0; i < 200; i++) {
+            wal.add("t" + std::to_string(t) + "_" + std::to_string(i), "v", t * 1000 + i);
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    auto records = Wal::read(path);
+    ASSERT_EQ(records.size(), 8u * 200);
+    // 同一个写者的记录保持写入顺序
+    std::vector<int> next(8, 0);
+    for (const auto& record : records) {
+      int t = static_cast<int>(record.transaction_id / 1000);
+      EXPECT_EQ(record.transaction_id % 1000, static_cast<uint64_t>(next[t]));
+      next[t]++;
+    }
+  }
+}
+
+// memtable 打开日志后, 重启时可以从日志恢复
+TEST_F(WalTest, MemtableRecovery) {
+  {
+    MemTable memtable;
+    memtable.open_wal(path);
+    memtable.put("key1", "value1", 1);
+    memtable.put_mutex("key2", "value2", 2);
+    memtable.put_batch({{"key3", "value3"}, {"key4", "value4"}}, 3);
+    memtable.remove("key1", 4);
+    memtable.remove_batch({"key4"}, 5);
+  }
+  MemTable memtable;
+  memtable.open_wal(path);
+  EXPECT_FALSE(memtable.get("key1").has_value());
+  EXPECT_EQ(memtable.cur_get("key1", 3).getValue().second, "value1");
+  EXPECT_EQ(memtable.get("key2").value(), "value2");
+  EXPECT_EQ(memtable.get("key3").value(), "value3");
+  EXPECT_FALSE(memtable.get("key4").has_value());
+  memtable.put("key5", "value5", 6);
+  // 上次的段还在活跃表中, 新的写入追加到新的段
+  EXPECT_EQ(segments().size(), 2u);
+  EXPECT_EQ(segment_records(), 7u);
+}
+
+// 每张活跃表一个日志段, 表刷盘后删除它的段, 重启只重放未刷盘的段
+TEST_F(WalTest, MemtableSegments) {
+  std::string sst_dir = dir + "/wal_sst";
+  std::filesystem::remove_all(sst_dir);
+  std::filesystem::create_directories(sst_dir);
+  {
+    MemTable memtable;
+    memtable.open_wal(path, Global_::WalSyncMode::kNone);
+    memtable.put("key1", "value1", 1);
+    memtable.frozen_cur_table();
+    memtable.put("key2", "value2", 2);
+    EXPECT_EQ(segments().size(), 2u);
+    memtable.start_flush_thread(std::make_shared<BlockCache>(4096, 2), sst_dir);
+    memtable.wait_for_flush();
+    memtable.stop_flush_thread();
+    auto remaining = segments();
+    ASSERT_EQ(remaining.size(), 1u);
+    EXPECT_EQ(Wal::read(remaining.front()).size(), 1u);
+  }
+  {
+    MemTable memtable;
+    memtable.open_wal(path, Global_::WalSyncMode::kNone);
+    // key1 在 SST 中, 不再从日志重放
+    EXPECT_FALSE(memtable.get("key1").has_value());
+    EXPECT_EQ(memtable.get("key2").value(), "value2");
+  }
+  remove_wal();
+
+  // 旧版本的单个日志文件作为最旧的段重放, 表满时冻结
+  const std::string value(1024, 'v');
+  const int         count = Global_::MAX_MEMTABLE_SIZE_PER_TABLE / 1024 + 1024;
+  {
+    Wal wal(path, Global_::WalSyncMode::kNone);
+    for (int i = 0; i < count; ++i) {
+      wal.add("key" + std::to_string(i), value, i + 1);
+    }
+  }
+  MemTable memtable;
+  memtable.open_wal(path, Global_::WalSyncMode::kNone);
+  EXPECT_FALSE(std::filesystem::exists(path));
+  EXPECT_GT(memtable.get_fixed_size(), 0u);
+  EXPECT_EQ(memtable.get("key0").value(), value);
+  EXPECT_EQ(memtable.get("key" + std::to_string(count - 1)).value(), value);
+  EXPECT_EQ(segment_records(), static_cast<size_t>(count));
+  std::filesystem::remove_all(sst_dir);
+}
+
+// 同步刷盘写入 sstbuild 的表的日志段保留到调用方建好 SST 之后
+TEST_F(WalTest, MemtableSyncFlushSegments) {
+  std::string sst_path = dir + "/wal_sync.sst";
+  auto        cache    = std::make_shared<BlockCache>(4096, 2);
+  {
+    MemTable memtable;
+    memtable.open_wal(path, Global_::WalSyncMode::kNone);
+    memtable.put("key1", "old", 1);
+    memtable.frozen_cur_table();
+    memtable.put("key1", "new", 2);
+    memtable.put("key2", "value2", 2);
+    memtable.frozen_cur_table();
+    memtable.put("key0", "value0", 3);
+    ASSERT_EQ(segments().size(), 3u);
+
+    // flushsync 写入活跃表和所有不可变表
+    Sstbuild builder(4096, true);
+    memtable.flushsync(builder);
+    EXPECT_EQ(segment_records(), 4u);
+    auto sst = builder.build(cache, sst_path, 0);
+    memtable.release_flushed_wal();
+    EXPECT_EQ(segment_records(), 0u);
+    EXPECT_EQ(sst->get_Iterator("key0", 3).value(), "value0");
+    EXPECT_EQ(sst->get_Iterator("key1", 3).value(), "new");
+    EXPECT_EQ(sst->get_Iterator("key2", 3).value(), "value2");
+  }
+  remove_wal();
+
+  const std::string value(1024, 'v');
+  const int         count = Global_::MAX_MEMTABLE_SIZE_PER_TABLE / 1024 + 1024;
+  MemTable          memtable;
+  memtable.open_wal(path, Global_::WalSyncMode::kNone);
+  for (int i = 0; i < count; ++i) {
+    memtable.put("key" + std::to_string(i), value, i + 1);
+  }
+  // flush 写入最旧的不可变表, 建 SST 之前它的段还在
+  Sstbuild builder(4096, true);
+  memtable.flush(builder);
+  EXPECT_EQ(segment_records(), static_cast<size_t>(count));
+  EXPECT_TRUE(std::filesystem::exists(path + ".1"));
+  builder.build(cache, sst_path, 1);
+  memtable.release_flushed_wal();
+  EXPECT_FALSE(std::filesystem::exists(path + ".1"));
+  EXPECT_EQ(segment_records(), 0u);
+  std::filesystem::remove(sst_path);
+}
+
+// CRC32C 的标准测试向量; 硬件实现和 slicing-by-8 在任意长度、任意对齐和分段计算时结果相同
+TEST_F(WalTest, Crc32c) {
+  EXPECT_EQ(crc32c("123456789", 9), 0xE3069283u);
+  EXPECT_EQ(crc32c_portable("123456789", 9), 0xE3069283u);
+  std::vector<uint8_t> zeros(32, 0);
+  EXPECT_EQ(crc32c(zeros.data(), zeros.size()), 0x8A9136AAu);
+
+  std::vector<uint8_t> data(1024);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+  for (size_t begin = 0; begin < 9; ++begin) {
+    for (size_t len = 0; begin + len <= data.size(); len += 37) {
+      uint32_t expected = crc32c_portable(data.data() + begin, len);
+      EXPECT_EQ(crc32c(data.data() + begin, len), expected);
+      size_t half = len / 2;
+      EXPECT_EQ(crc32c(data.data() + begin + half, len - half, crc32c(data.data() + begin, half)),
+                expected);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}